@@ -0,0 +1,608 @@
+#include "treenode.h"
+#include "tree.h"
+#include "treemap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+// Every run uses the same keys and the same order of operations
+static const unsigned seed = 42;
+// Skew of the Zipf distribution, the one YCSB uses
+static const double zipfExponent = 0.99;
+// Operations are timed in batches of this many, the latency percentiles are those of the batch averages
+static const size_t batchSize = 16;
+// Small sizes repeat their workload until at least this many operations were timed
+static const size_t minOperations = 1 << 20;
+// Number of elements visited by one range-scan query
+static const size_t rangeLength = 100;
+// Nanoseconds the two clock reads around a batch take, measured once by calibrateTimer and taken off every batch
+static double timerOverhead = 0;
+
+/**
+ * A 256-byte Value, for maps whose Values are expensive to copy.
+ */
+struct LargeValue {
+
+    unsigned char bytes[256];
+
+    LargeValue()
+        : bytes() {
+    }
+};
+
+/**
+ * Draws ranks 1..n with the probability of rank k proportional to 1 / k^s, in O(1) per draw and without any table,
+ * by rejection-inversion (Hörmann and Derflinger, 1996), so that it works for n up to 1e8.
+ */
+class ZipfGenerator {
+
+private:
+
+    double exponent;
+    double n;
+    double hIntegralX1;
+    double hIntegralN;
+    double s;
+
+    static double helper1(double x) {
+        return std::fabs(x) > 1e-8 ? std::log1p(x) / x : 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+    }
+
+    static double helper2(double x) {
+        return std::fabs(x) > 1e-8 ? std::expm1(x) / x : 1 + x * 0.5 * (1 + x * (1.0 / 3) * (1 + 0.25 * x));
+    }
+
+    double h(double x) const {
+        return std::exp(-exponent * std::log(x));
+    }
+
+    double hIntegral(double x) const {
+        double logX = std::log(x);
+        return helper2((1 - exponent) * logX) * logX;
+    }
+
+    double hIntegralInverse(double x) const {
+        double t = x * (1 - exponent);
+        if (t < -1) {
+            t = -1;
+        }
+        return std::exp(helper1(t) * x);
+    }
+
+public:
+
+    ZipfGenerator(size_t count, double exponentIn)
+        : exponent(exponentIn), n(static_cast<double>(count)) {
+        hIntegralX1 = hIntegral(1.5) - 1;
+        hIntegralN = hIntegral(n + 0.5);
+        s = 2 - hIntegralInverse(hIntegral(2.5) - h(2));
+    }
+
+    /**
+     * Draw a rank.
+     * @return rank between 1 and n, 1 being the most frequent.
+     */
+    template<typename Generator>
+    size_t operator()(Generator & generator) {
+        std::uniform_real_distribution<double> uniform(0, 1);
+        for (;;) {
+            double u = hIntegralN + uniform(generator) * (hIntegralX1 - hIntegralN);
+            double x = hIntegralInverse(u);
+            double k = std::floor(x + 0.5);
+            if (k < 1) {
+                k = 1;
+            }
+            else if (k > n) {
+                k = n;
+            }
+            if (k - x <= s || u >= hIntegral(k + 0.5) - h(k)) {
+                return static_cast<size_t>(k);
+            }
+        }
+    }
+};
+
+/**
+ * Make the order in which the indices 0..n-1 of the elements are used by the operations.
+ * @param distribution "sequential" (ascending), "random" (a random permutation) or "zipf" (n draws, the most
+ * popular indices being scattered over the key space).
+ * @param n Number of elements.
+ * @return the indices.
+ */
+vector<size_t> makeIndices(const string & distribution, size_t n) {
+    vector<size_t> indices(n);
+    std::mt19937_64 generator(seed);
+    if (distribution == "zipf") {
+        ZipfGenerator zipf(n, zipfExponent);
+        for (size_t i = 0; i < n; ++i) {
+            // Multiplying by a prime bigger than n permutes 0..n-1, so rank 1 is not always the smallest key
+            indices[i] = static_cast<size_t>((static_cast<uint64_t>(zipf(generator) - 1) * 2654435761ull) % n);
+        }
+        return indices;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        indices[i] = i;
+    }
+    if (distribution == "random") {
+        std::shuffle(indices.begin(), indices.end(), generator);
+    }
+    return indices;
+}
+
+/**
+ * Make the key of the element at the index: the elements have the even keys, the odd ones are misses.
+ */
+template<typename Key>
+Key makeKey(size_t value);
+
+template<>
+int makeKey<int>(size_t value) {
+    return static_cast<int>(value);
+}
+
+template<>
+string makeKey<string>(size_t value) {
+    // Zero padded, so that the strings are in the same order as the numbers
+    char text[32];
+    std::snprintf(text, sizeof(text), "user-%012llu", static_cast<unsigned long long>(value));
+    return text;
+}
+
+/**
+ * Turn an element into a number, so that the scans have something to add up that the compiler cannot drop.
+ */
+size_t weightOf(int key) {
+    return static_cast<size_t>(key);
+}
+
+size_t weightOf(const string & key) {
+    return key.size();
+}
+
+template<typename Key, typename Value>
+size_t weightOf(const KeyValuePair<Key, Value> & pair) {
+    return weightOf(pair.k);
+}
+
+template<typename Key, typename Value>
+size_t weightOf(const std::pair<const Key, Value> & pair) {
+    return weightOf(pair.first);
+}
+
+/**
+ * How the benchmark inserts into and looks up a container, for the containers with the interface of std::set.
+ */
+template<typename Container>
+struct SetOperations {
+
+    template<typename Key>
+    static bool insert(Container & container, const Key & key) {
+        return container.insert(key).second;
+    }
+
+    template<typename Key>
+    static bool contains(const Container & container, const Key & key) {
+        return container.find(key) != container.end();
+    }
+};
+
+template<typename T>
+struct SetOperations<BinarySearchTree<T> > {
+
+    static bool insert(BinarySearchTree<T> & tree, const T & key) {
+        return tree.insert(key) != nullptr;
+    }
+
+    static bool contains(const BinarySearchTree<T> & tree, const T & key) {
+        return tree.find(key) != nullptr;
+    }
+};
+
+/**
+ * How the benchmark inserts into and looks up a container, for the containers with the interface of std::map.
+ */
+template<typename Container>
+struct MapOperations {
+
+    template<typename Key>
+    static bool insert(Container & container, const Key & key) {
+        return container.emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple()).second;
+    }
+
+    template<typename Key>
+    static bool contains(const Container & container, const Key & key) {
+        return container.find(key) != container.end();
+    }
+};
+
+template<typename Key, typename Value>
+struct MapOperations<TreeMap<Key, Value> > {
+
+    static bool insert(TreeMap<Key, Value> & map, const Key & key) {
+        return map.try_emplace(key).second;
+    }
+
+    static bool contains(const TreeMap<Key, Value> & map, const Key & key) {
+        return map.find(key) != nullptr;
+    }
+};
+
+/**
+ * Get the resident set size of the process.
+ * @return bytes of memory in RAM, 0 if the platform does not tell.
+ */
+size_t residentBytes() {
+#if defined(__linux__)
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0;
+    size_t resident = 0;
+    if (statm >> pages >> resident) {
+        return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+    return 0;
+#elif defined(__APPLE__)
+    // Only the peak is available here
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Give the memory freed by the previous containers back to the system, so that the next resident set size
+ * difference is the memory of the next container.
+ */
+void releaseFreeMemory() {
+#if defined(__GLIBC__)
+    malloc_trim(0);
+#endif
+}
+
+/**
+ * Result of timing a workload.
+ */
+struct Measurement {
+
+    double nsPerOp;
+    double p50;
+    double p99;
+    // false when every sample covers a whole container, whose percentiles are not per-operation latencies
+    bool hasPercentiles;
+    size_t checksum;
+
+    Measurement()
+        : nsPerOp(0), p50(0), p99(0), hasPercentiles(true), checksum(0) {
+    }
+};
+
+/**
+ * Measure what timing an empty batch costs, so that the percentiles compare the containers rather than the clock:
+ * with batches of 16 lookups of 20 to 60 ns the two steady_clock::now() calls are a large part of every sample.
+ * @return median nanoseconds between two back-to-back steady_clock::now() calls.
+ */
+double calibrateTimer() {
+    vector<double> samples(100001);
+    for (double & sample : samples) {
+        auto start = std::chrono::steady_clock::now();
+        auto stop = std::chrono::steady_clock::now();
+        sample = std::chrono::duration<double, std::nano>(stop - start).count();
+    }
+    std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+    return samples[samples.size() / 2];
+}
+
+/**
+ * Time count operations in batches of batchSize, adding the batches to the ones timed before. The timer overhead is
+ * taken off every batch.
+ * @param count Number of operations.
+ * @param operation Function performing operation i and returning a number to add to the checksum.
+ * @param batches Nanoseconds per operation of every batch.
+ * @return checksum of the operations.
+ */
+template<typename Operation>
+size_t timeBatches(size_t count, Operation operation, vector<double> & batches) {
+    size_t checksum = 0;
+    for (size_t first = 0; first < count; first += batchSize) {
+        size_t last = std::min(count, first + batchSize);
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = first; i < last; ++i) {
+            checksum += operation(i);
+        }
+        auto stop = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double, std::nano>(stop - start).count() - timerOverhead;
+        batches.push_back(std::max(0.0, elapsed) / (last - first));
+    }
+    return checksum;
+}
+
+/**
+ * Summarise the batches of a workload.
+ * @param batches Nanoseconds per operation of every batch, reordered.
+ * @param checksum Checksum of the operations.
+ * @return the Measurement.
+ */
+Measurement summarise(vector<double> & batches, size_t checksum) {
+    Measurement measurement;
+    measurement.checksum = checksum;
+    if (batches.empty()) {
+        return measurement;
+    }
+    double total = 0;
+    for (double batch : batches) {
+        total += batch;
+    }
+    measurement.nsPerOp = total / batches.size();
+    size_t middle = batches.size() / 2;
+    size_t tail = std::min(batches.size() - 1, batches.size() * 99 / 100);
+    std::nth_element(batches.begin(), batches.begin() + middle, batches.end());
+    measurement.p50 = batches[middle];
+    std::nth_element(batches.begin(), batches.begin() + tail, batches.end());
+    measurement.p99 = batches[tail];
+    return measurement;
+}
+
+/**
+ * Results of every workload on one container.
+ */
+struct ContainerResults {
+
+    vector<std::pair<string, Measurement> > workloads;
+    size_t bytes;
+
+    ContainerResults()
+        : bytes(0) {
+    }
+};
+
+/**
+ * Run every workload on one container of n elements.
+ * @tparam Container The container.
+ * @tparam Operations SetOperations or MapOperations of the container.
+ * @tparam Key Key of the container.
+ * @param n Number of elements.
+ * @param order Indices in the order of the distribution, see makeIndices.
+ * @param buildOrder Indices in the order in which to build the container that the lookups run on.
+ * @return the results.
+ */
+template<typename Container, typename Operations, typename Key>
+ContainerResults runWorkloads(size_t n, const vector<size_t> & order, const vector<size_t> & buildOrder) {
+    ContainerResults results;
+    const size_t rounds = std::max<size_t>(1, minOperations / n);
+    vector<Key> hits;
+    vector<Key> misses;
+    hits.reserve(n);
+    misses.reserve(n);
+    for (size_t index : order) {
+        hits.push_back(makeKey<Key>(2 * index));
+        misses.push_back(makeKey<Key>(2 * index + 1));
+    }
+    vector<double> batches;
+
+    // insert: the keys of the distribution into an empty container, a Zipf distribution repeating its popular keys
+    for (size_t round = 0; round < rounds; ++round) {
+        Container container;
+        size_t checksum = timeBatches(n, [&](size_t i) {
+            return static_cast<size_t>(Operations::insert(container, hits[i]));
+        }, batches);
+        if (round + 1 == rounds) {
+            results.workloads.push_back(std::make_pair("insert", summarise(batches, checksum)));
+        }
+    }
+    batches.clear();
+
+    // Every other workload runs on a container holding all n elements
+    releaseFreeMemory();
+    size_t before = residentBytes();
+    Container container;
+    for (size_t index : buildOrder) {
+        Operations::insert(container, makeKey<Key>(2 * index));
+    }
+    size_t after = residentBytes();
+    results.bytes = after > before ? after - before : 0;
+    const Container & view = container;
+
+    size_t checksum = 0;
+    for (size_t round = 0; round < rounds; ++round) {
+        checksum += timeBatches(n, [&](size_t i) {
+            return static_cast<size_t>(Operations::contains(view, hits[i]));
+        }, batches);
+    }
+    results.workloads.push_back(std::make_pair("find-hit", summarise(batches, checksum)));
+    batches.clear();
+
+    checksum = 0;
+    for (size_t round = 0; round < rounds; ++round) {
+        checksum += timeBatches(n, [&](size_t i) {
+            return static_cast<size_t>(Operations::contains(view, misses[i]));
+        }, batches);
+    }
+    results.workloads.push_back(std::make_pair("find-miss", summarise(batches, checksum)));
+    batches.clear();
+
+    // full-scan: one operation is one element, the iterator being advanced in batches of batchSize elements
+    checksum = 0;
+    for (size_t round = 0; round < rounds; ++round) {
+        auto position = view.begin();
+        checksum += timeBatches(n, [&](size_t) {
+            size_t weight = weightOf(*position);
+            ++position;
+            return weight;
+        }, batches);
+    }
+    results.workloads.push_back(std::make_pair("full-scan", summarise(batches, checksum)));
+    batches.clear();
+
+    // range-scan: one operation is a lower_bound and the rangeLength elements from there
+    const size_t queries = std::max<size_t>(1, n / rangeLength);
+    const size_t queryRounds = std::max<size_t>(1, minOperations / (queries * rangeLength));
+    checksum = 0;
+    for (size_t round = 0; round < queryRounds; ++round) {
+        checksum += timeBatches(queries, [&](size_t i) {
+            size_t weight = 0;
+            size_t visited = 0;
+            for (auto position = view.lower_bound(hits[i]); position != view.end() && visited < rangeLength;
+                 ++position, ++visited) {
+                weight += weightOf(*position);
+            }
+            return weight;
+        }, batches);
+    }
+    results.workloads.push_back(std::make_pair("range-scan", summarise(batches, checksum)));
+    batches.clear();
+
+    // copy: one operation is one element, the copy is timed as a whole and destroyed outside of the timing. Every
+    // round gives a single sample for the whole container, so only the mean per element is reported
+    Measurement copyMeasurement;
+    copyMeasurement.hasPercentiles = false;
+    double total = 0;
+    for (size_t round = 0; round < rounds; ++round) {
+        auto start = std::chrono::steady_clock::now();
+        Container * copy = new Container(view);
+        auto stop = std::chrono::steady_clock::now();
+        total += std::max(0.0, std::chrono::duration<double, std::nano>(stop - start).count() - timerOverhead);
+        copyMeasurement.checksum += copy->size();
+        delete copy;
+    }
+    copyMeasurement.nsPerOp = total / (rounds * n);
+    results.workloads.push_back(std::make_pair("copy", copyMeasurement));
+
+    return results;
+}
+
+/**
+ * Print the ns per operation and the percentiles of a Measurement, with a dash for the percentiles it does not have.
+ */
+void printMeasurement(const Measurement & measurement) {
+    cout << std::setw(10) << measurement.nsPerOp;
+    if (measurement.hasPercentiles) {
+        cout << std::setw(10) << measurement.p50 << std::setw(10) << measurement.p99;
+    } else {
+        cout << std::setw(10) << "-" << std::setw(10) << "-";
+    }
+}
+
+/**
+ * Print one row per workload comparing the tree with the standard container.
+ */
+void printRows(const string & payload, const string & distribution, size_t n, const ContainerResults & tree,
+               const ContainerResults & standard) {
+    for (size_t i = 0; i < tree.workloads.size(); ++i) {
+        const Measurement & a = tree.workloads[i].second;
+        const Measurement & b = standard.workloads[i].second;
+        cout << std::left << std::setw(8) << payload << std::setw(12) << distribution << std::right
+             << std::setw(11) << n << "  " << std::left << std::setw(11) << tree.workloads[i].first << std::right
+             << std::fixed << std::setprecision(1);
+        printMeasurement(a);
+        printMeasurement(b);
+        cout << std::setw(10) << std::setprecision(2) << (b.nsPerOp > 0 ? a.nsPerOp / b.nsPerOp : 0);
+        if (a.checksum != b.checksum) {
+            cout << "  checksum mismatch " << a.checksum << " != " << b.checksum;
+        }
+        cout << endl;
+    }
+    cout << std::left << std::setw(8) << payload << std::setw(12) << distribution << std::right << std::setw(11) << n
+         << "  " << std::left << std::setw(11) << "rss MiB" << std::right << std::fixed << std::setprecision(1)
+         << std::setw(10) << tree.bytes / 1048576.0 << std::setw(20) << ""
+         << std::setw(10) << standard.bytes / 1048576.0 << std::setw(20) << ""
+         << std::setw(10) << std::setprecision(2)
+         << (standard.bytes > 0 ? static_cast<double>(tree.bytes) / standard.bytes : 0) << endl;
+}
+
+/**
+ * Run every distribution and size for one payload, the tree against the standard container.
+ */
+template<typename Tree, typename TreeOperations, typename Standard, typename StandardOperations, typename Key>
+void runPayload(const string & payload, const vector<size_t> & sizes) {
+    const char * distributions[] = {"sequential", "random", "zipf"};
+    for (size_t n : sizes) {
+        vector<size_t> randomOrder = makeIndices("random", n);
+        for (const char * distribution : distributions) {
+            vector<size_t> order = makeIndices(distribution, n);
+            // The lookups of the Zipf distribution run on a container built in random order
+            const vector<size_t> & buildOrder = string(distribution) == "sequential" ? order : randomOrder;
+            ContainerResults tree = runWorkloads<Tree, TreeOperations, Key>(n, order, buildOrder);
+            ContainerResults standard = runWorkloads<Standard, StandardOperations, Key>(n, order, buildOrder);
+            printRows(payload, distribution, n, tree, standard);
+        }
+    }
+}
+
+int main(int argc, char ** argv) {
+
+    size_t maxSize = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    vector<string> payloads;
+    for (int i = 2; i < argc; ++i) {
+        payloads.push_back(argv[i]);
+    }
+    if (payloads.empty()) {
+        payloads = {"int", "string", "large"};
+    }
+    vector<size_t> sizes;
+    for (size_t n = 1000; n <= maxSize; n *= 10) {
+        sizes.push_back(n);
+    }
+
+    timerOverhead = calibrateTimer();
+
+    cout << "seed " << seed << ", zipf exponent " << zipfExponent << ", percentiles over batches of " << batchSize
+         << " operations, at least " << minOperations << " operations per measurement" << endl;
+    cout << "timer overhead " << std::fixed << std::setprecision(1) << timerOverhead
+         << " ns per batch, taken off every batch before it is divided by the operations in it" << endl;
+    cout << "tree: BinarySearchTree (int, string) and TreeMap with 256-byte Values (large); std: std::set and std::map"
+         << endl;
+    cout << std::left << std::setw(8) << "payload" << std::setw(12) << "dist" << std::right << std::setw(11) << "n"
+         << "  " << std::left << std::setw(11) << "workload" << std::right
+         << std::setw(10) << "tree ns" << std::setw(10) << "p50" << std::setw(10) << "p99"
+         << std::setw(10) << "std ns" << std::setw(10) << "p50" << std::setw(10) << "p99"
+         << std::setw(10) << "tree/std" << endl;
+
+    for (const string & payload : payloads) {
+        if (payload == "int") {
+            runPayload<BinarySearchTree<int>, SetOperations<BinarySearchTree<int> >,
+                       std::set<int>, SetOperations<std::set<int> >, int>(payload, sizes);
+        }
+        else if (payload == "string") {
+            runPayload<BinarySearchTree<string>, SetOperations<BinarySearchTree<string> >,
+                       std::set<string>, SetOperations<std::set<string> >, string>(payload, sizes);
+        }
+        else if (payload == "large") {
+            runPayload<TreeMap<int, LargeValue>, MapOperations<TreeMap<int, LargeValue> >,
+                       std::map<int, LargeValue>, MapOperations<std::map<int, LargeValue> >, int>(payload, sizes);
+        }
+        else {
+            std::cerr << "unknown payload " << payload << ", expected int, string or large" << endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
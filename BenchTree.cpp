@@ -0,0 +1,588 @@
+#include "treenode.h"
+#include "tree.h"
+#include "treemap.h"
+#include "compacttree.h"
+#include "concurrenttreemap.h"
+#include "persistenttree.h"
+#include "mappedtreemap.h"
+#include "btree.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+/**
+ * Time a piece of work and report it in nanoseconds per operation.
+ * @param name Name of the benchmark to print.
+ * @param operations Number of operations the work performs.
+ * @param work Work to time.
+ */
+template<typename Work>
+void measure(const string & name, size_t operations, Work work) {
+    auto start = std::chrono::steady_clock::now();
+    size_t checksum = work();
+    auto stop = std::chrono::steady_clock::now();
+    double nanoseconds = std::chrono::duration<double, std::nano>(stop - start).count();
+    cout << name << ": " << nanoseconds / operations << " ns/op (checksum " << checksum << ")" << endl;
+}
+
+/**
+ * Make n distinct keys in random order, followed by n keys that are not among them.
+ */
+vector<int> makeIntKeys(size_t n) {
+    vector<int> keys(2 * n);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        keys[i] = static_cast<int>(i);
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+    return keys;
+}
+
+/**
+ * Make the same keys as makeIntKeys, spread over the whole 64-bit range.
+ */
+vector<int64_t> makeInt64Keys(size_t n) {
+    vector<int> ints = makeIntKeys(n);
+    vector<int64_t> keys;
+    keys.reserve(ints.size());
+    for (int i : ints) {
+        keys.push_back(static_cast<int64_t>(static_cast<uint64_t>(i) * 0x9E3779B97F4A7C15ull));
+    }
+    return keys;
+}
+
+/**
+ * Make the same keys as makeIntKeys, as long strings that share a prefix and a suffix.
+ */
+vector<string> makeStringKeys(size_t n) {
+    vector<int> ints = makeIntKeys(n);
+    vector<string> keys;
+    keys.reserve(ints.size());
+    for (int i : ints) {
+        keys.push_back("session-key-" + std::to_string(i) + "-with-a-long-common-suffix");
+    }
+    return keys;
+}
+
+/**
+ * Benchmark insert, find-hit, find-miss and destruction for the provided keys. The first half of the keys are
+ * inserted, the second half are used for the misses.
+ */
+template<typename Tree, typename T>
+void benchmarkFindAndInsert(const string & name, const vector<T> & keys) {
+    const size_t n = keys.size() / 2;
+    unique_ptr<Tree> treePointer(new Tree());
+    Tree & tree = *treePointer;
+
+    measure(name + " insert", n, [&]() {
+        size_t inserted = 0;
+        for (size_t i = 0; i < n; ++i) {
+            inserted += tree.insert(keys[i]) != nullptr;
+        }
+        return inserted;
+    });
+
+    measure(name + " find-hit", n, [&]() {
+        size_t found = 0;
+        for (size_t i = 0; i < n; ++i) {
+            found += tree.find(keys[i]) != nullptr;
+        }
+        return found;
+    });
+
+    measure(name + " find-miss", n, [&]() {
+        size_t found = 0;
+        for (size_t i = n; i < keys.size(); ++i) {
+            found += tree.find(keys[i]) != nullptr;
+        }
+        return found;
+    });
+
+    measure(name + " destroy", n, [&]() {
+        treePointer.reset();
+        return n;
+    });
+}
+
+/**
+ * Benchmark loading n sorted ints by repeated insertion against building the tree directly with fromSorted.
+ */
+void benchmarkSortedLoad(size_t n) {
+    vector<int> keys(n);
+    for (size_t i = 0; i < n; ++i) {
+        keys[i] = static_cast<int>(i);
+    }
+
+    BinarySearchTree<int> inserted;
+    measure("int sorted load by insert", n, [&]() {
+        for (int key : keys) {
+            inserted.insert(key);
+        }
+        return static_cast<size_t>(inserted.maxDepth());
+    });
+
+    unique_ptr<BinarySearchTree<int> > built;
+    measure("int sorted load by fromSorted", n, [&]() {
+        built.reset(new BinarySearchTree<int>(BinarySearchTree<int>::fromSorted(keys.begin(), keys.end())));
+        return static_cast<size_t>(built->maxDepth());
+    });
+}
+
+/**
+ * Benchmark the copy constructor against rebuilding the same tree by inserting n random keys.
+ */
+template<typename Tree>
+void benchmarkCopy(const string & name, const vector<int> & keys) {
+    const size_t n = keys.size() / 2;
+    Tree tree;
+    for (size_t i = 0; i < n; ++i) {
+        tree.insert(keys[i]);
+    }
+
+    unique_ptr<Tree> rebuilt(new Tree());
+    measure(name + " rebuild by insert", n, [&]() {
+        for (size_t i = 0; i < n; ++i) {
+            rebuilt->insert(keys[i]);
+        }
+        return static_cast<size_t>(rebuilt->maxDepth());
+    });
+
+    unique_ptr<Tree> copy;
+    measure(name + " copy", n, [&]() {
+        copy.reset(new Tree(tree));
+        return static_cast<size_t>(copy->maxDepth());
+    });
+}
+
+/**
+ * Benchmark a full scan of a tree of n random keys with the iterators against forEach, and a range scan over the
+ * middle half of the keys with a range view against scan.
+ */
+template<typename Tree>
+void benchmarkScan(const string & name, const vector<int> & keys) {
+    const size_t n = keys.size() / 2;
+    Tree tree;
+    for (size_t i = 0; i < n; ++i) {
+        tree.insert(keys[i]);
+    }
+    const int lo = static_cast<int>(n / 2);
+    const int hi = static_cast<int>(n + n / 2);
+
+    measure(name + " full scan by iterator", n, [&]() {
+        size_t sum = 0;
+        for (int e : tree) {
+            sum += e;
+        }
+        return sum;
+    });
+
+    measure(name + " full scan by forEach", n, [&]() {
+        size_t sum = 0;
+        tree.forEach([&](int e) { sum += e; });
+        return sum;
+    });
+
+    measure(name + " range scan by iterator", n / 2, [&]() {
+        size_t sum = 0;
+        for (int e : tree.range(lo, hi)) {
+            sum += e;
+        }
+        return sum;
+    });
+
+    measure(name + " range scan by scan", n / 2, [&]() {
+        size_t sum = 0;
+        tree.scan(lo, hi, [&](int e) { sum += e; });
+        return sum;
+    });
+}
+
+/**
+ * Run a mix of reads and writes of random keys on several threads at once and report the time per operation over all
+ * threads. Writes insert odd keys and erase even ones, so the size of the map stays about the same.
+ */
+template<typename Read, typename Write>
+void measureMix(const string & name, size_t threads, unsigned readPercent, size_t operationsPerThread, int keyRange,
+                Read read, Write write) {
+    measure(name + " " + std::to_string(threads) + " threads " + std::to_string(readPercent) + "% reads",
+            threads * operationsPerThread, [&]() {
+        std::atomic<size_t> checksum(0);
+        vector<std::thread> workers;
+        for (size_t t = 0; t < threads; ++t) {
+            workers.push_back(std::thread([&, t]() {
+                std::mt19937 generator(static_cast<unsigned>(t));
+                size_t found = 0;
+                for (size_t i = 0; i < operationsPerThread; ++i) {
+                    int key = static_cast<int>(generator() % keyRange);
+                    if (generator() % 100 < readPercent) {
+                        found += read(key);
+                    }
+                    else {
+                        write(key);
+                    }
+                }
+                checksum += found;
+            }));
+        }
+        for (std::thread & worker : workers) {
+            worker.join();
+        }
+        return checksum.load();
+    });
+}
+
+/**
+ * Benchmark the ConcurrentTreeMap against a TreeMap behind one mutex, for several thread counts and read/write mixes.
+ */
+void benchmarkConcurrent(size_t n) {
+    const int keyRange = static_cast<int>(2 * n);
+    const size_t operationsPerThread = 200000;
+
+    ConcurrentTreeMap<int, int> concurrent;
+    TreeMap<int, int> locked;
+    std::mutex lock;
+    for (int key = 1; key < keyRange; key += 2) {
+        concurrent.insert(key, key);
+        locked.insert(key, key);
+    }
+
+    for (unsigned readPercent : {100u, 99u, 90u, 50u}) {
+        for (size_t threads : {1u, 2u, 4u, 8u}) {
+            measureMix("ConcurrentTreeMap", threads, readPercent, operationsPerThread, keyRange,
+                       [&](int key) {
+                           return concurrent.contains(key);
+                       },
+                       [&](int key) {
+                           if (key & 1) {
+                               concurrent.insert(key, key);
+                           }
+                           else {
+                               concurrent.erase(key);
+                           }
+                       });
+
+            measureMix("TreeMap + mutex", threads, readPercent, operationsPerThread, keyRange,
+                       [&](int key) {
+                           std::lock_guard<std::mutex> guard(lock);
+                           return locked.find(key) != nullptr;
+                       },
+                       [&](int key) {
+                           std::lock_guard<std::mutex> guard(lock);
+                           if (key & 1) {
+                               locked.insert(key, key);
+                           }
+                           else {
+                               locked.erase(key);
+                           }
+                       });
+        }
+    }
+}
+
+/**
+ * Benchmark the PersistentBinarySearchTree: inserting n random keys into new versions against the mutable tree, and
+ * taking snapshots against copying the mutable tree.
+ */
+void benchmarkPersistent(const vector<int> & keys) {
+    const size_t n = keys.size() / 2;
+    const size_t snapshots = 100;
+
+    BinarySearchTree<int> tree;
+    measure("int insert", n, [&]() {
+        for (size_t i = 0; i < n; ++i) {
+            tree.insert(keys[i]);
+        }
+        return tree.size();
+    });
+
+    PersistentBinarySearchTree<int> persistent;
+    measure("int persistent insert", n, [&]() {
+        for (size_t i = 0; i < n; ++i) {
+            persistent = persistent.insert(keys[i]);
+        }
+        return persistent.size();
+    });
+
+    measure("int copy as snapshot", snapshots, [&]() {
+        size_t total = 0;
+        for (size_t i = 0; i < snapshots; ++i) {
+            BinarySearchTree<int> copy(tree);
+            total += copy.size();
+        }
+        return total;
+    });
+
+    measure("int persistent snapshot", snapshots, [&]() {
+        size_t total = 0;
+        for (size_t i = 0; i < snapshots; ++i) {
+            PersistentBinarySearchTree<int> snapshot = persistent.snapshot();
+            total += snapshot.size();
+        }
+        return total;
+    });
+}
+
+/**
+ * Benchmark inserting batches of 10000 and 100000 random keys into a tree of n keys, one by one against insertBatch.
+ */
+void benchmarkBatch(const vector<int> & keys) {
+    const size_t n = keys.size() / 2;
+    for (size_t batchSize : {10000u, 100000u}) {
+        if (batchSize > n) {
+            continue;
+        }
+        vector<int> loaded(keys.begin(), keys.begin() + n);
+        vector<int> batch(keys.begin() + n, keys.begin() + n + batchSize);
+        BinarySearchTree<int> oneByOne = BinarySearchTree<int>::fromUnsorted(loaded.begin(), loaded.end());
+        BinarySearchTree<int> batched = BinarySearchTree<int>::fromUnsorted(loaded.begin(), loaded.end());
+
+        measure("int batch of " + std::to_string(batchSize) + " by insert", batchSize, [&]() {
+            for (int key : batch) {
+                oneByOne.insert(key);
+            }
+            return oneByOne.size();
+        });
+
+        measure("int batch of " + std::to_string(batchSize) + " by insertBatch", batchSize, [&]() {
+            batched.insertBatch(batch.begin(), batch.end());
+            return batched.size();
+        });
+    }
+}
+
+/**
+ * Benchmark the union, intersection and difference of two trees of n random keys each (half of them shared), and the
+ * parallel bulk build, on 1 thread up to the number of hardware threads, against std::set_union over iterators.
+ */
+void benchmarkSetOperations(const vector<int> & keys) {
+    const size_t n = keys.size() / 2;
+    vector<int> first(keys.begin(), keys.begin() + n);
+    vector<int> second(keys.begin() + n / 2, keys.begin() + n / 2 + n);
+    std::sort(first.begin(), first.end());
+    std::sort(second.begin(), second.end());
+
+    measure("set union of 2 x " + std::to_string(n) + " by std::set_union and fromSorted", n, [&]() {
+        BinarySearchTree<int> a = BinarySearchTree<int>::fromSorted(first.begin(), first.end());
+        BinarySearchTree<int> b = BinarySearchTree<int>::fromSorted(second.begin(), second.end());
+        vector<int> united;
+        std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(united));
+        a = BinarySearchTree<int>::fromSorted(united.begin(), united.end());
+        return a.size();
+    });
+
+    unsigned hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned threads = 1; threads <= hardwareThreads; threads *= 2) {
+        string suffix = " on " + std::to_string(threads) + " threads";
+        measure("fromSorted of " + std::to_string(n) + suffix, n, [&]() {
+            return BinarySearchTree<int>::fromSorted(first.begin(), first.end(), threads).size();
+        });
+        const char * names[] = {"unionWith", "intersect", "difference"};
+        for (int operation = 0; operation < 3; ++operation) {
+            BinarySearchTree<int> a = BinarySearchTree<int>::fromSorted(first.begin(), first.end(), threads);
+            BinarySearchTree<int> b = BinarySearchTree<int>::fromSorted(second.begin(), second.end(), threads);
+            measure(string("set ") + names[operation] + " of 2 x " + std::to_string(n) + suffix, n, [&]() {
+                if (operation == 0) {
+                    a.unionWith(std::move(b), threads);
+                } else if (operation == 1) {
+                    a.intersect(std::move(b), threads);
+                } else {
+                    a.difference(std::move(b), threads);
+                }
+                return a.size();
+            });
+        }
+    }
+}
+
+/**
+ * Benchmark restoring a TreeMap of n keys from a binary snapshot file against inserting the keys again, and finding
+ * every key in a MappedTreeMap of the same file against the TreeMap.
+ */
+void benchmarkSnapshot(const vector<int> & keys) {
+    const size_t n = keys.size() / 2;
+    const char * path = "BenchTree.bin";
+    TreeMap<int, int> tree;
+    for (size_t i = 0; i < n; ++i) {
+        tree.insert(keys[i], static_cast<int>(i));
+    }
+    measure("snapshot writeBinary of " + std::to_string(n), n, [&]() {
+        std::ofstream out(path, std::ios::binary);
+        tree.writeBinary(out);
+        return tree.size();
+    });
+
+    measure("snapshot restore by insert", n, [&]() {
+        TreeMap<int, int> restored;
+        for (size_t i = 0; i < n; ++i) {
+            restored.insert(keys[i], static_cast<int>(i));
+        }
+        return restored.size();
+    });
+    measure("snapshot restore by readBinary", n, [&]() {
+        std::ifstream in(path, std::ios::binary);
+        TreeMap<int, int> restored;
+        restored.readBinary(in);
+        return restored.size();
+    });
+
+    MappedTreeMap<int, int> mapped;
+    measure("snapshot MappedTreeMap open", n, [&]() {
+        mapped.open(path);
+        return mapped.size();
+    });
+    measure("snapshot find-hit in TreeMap", n, [&]() {
+        size_t found = 0;
+        for (size_t i = 0; i < n; ++i) {
+            found += tree.find(keys[i]) != nullptr;
+        }
+        return found;
+    });
+    measure("snapshot find-hit in MappedTreeMap", n, [&]() {
+        size_t found = 0;
+        for (size_t i = 0; i < n; ++i) {
+            found += mapped.find(keys[i]) != nullptr;
+        }
+        return found;
+    });
+    mapped.close();
+    std::remove(path);
+}
+
+/**
+ * Time writing a tree into a string and report the throughput in MB/s.
+ * @param name Name of the benchmark to print.
+ * @param write Work that writes into the ostream it is given.
+ */
+template<typename Write>
+void measureThroughput(const string & name, Write write) {
+    std::ostringstream out;
+    auto start = std::chrono::steady_clock::now();
+    write(out);
+    auto stop = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(stop - start).count();
+    size_t bytes = out.str().size();
+    cout << name << ": " << bytes / seconds / 1e6 << " MB/s (" << bytes << " bytes)" << endl;
+}
+
+/**
+ * Benchmark writing a tree of n ints: an element at a time through operator<<, as the recursive write used to, against
+ * the buffered write, with and without a key range.
+ */
+void benchmarkWrite(const vector<int> & keys) {
+    const size_t n = keys.size() / 2;
+    BinarySearchTree<int> tree;
+    for (size_t i = 0; i < n; ++i) {
+        tree.insert(keys[i]);
+    }
+    measureThroughput("write " + std::to_string(n) + " ints by operator<<", [&](std::ostream & o) {
+        for (int e : tree) {
+            o << " " << e << " ";
+        }
+    });
+    measureThroughput("write " + std::to_string(n) + " ints by write", [&](std::ostream & o) {
+        tree.write(o);
+    });
+    measureThroughput("write " + std::to_string(n) + " ints by write with a separator", [&](std::ostream & o) {
+        tree.write(o, "\n");
+    });
+    measureThroughput("write ints in [n / 4, n / 2) by writeRange", [&](std::ostream & o) {
+        tree.writeRange(o, static_cast<int>(n / 4), static_cast<int>(n / 2), "\n");
+    });
+}
+
+/**
+ * Benchmark find-hit and find-miss in a frozen tree against the BinarySearchTree it was frozen from and against
+ * std::lower_bound over a sorted vector, for trees from a few thousand ints (fitting in L1) up to maxSize ints (far
+ * beyond the last level cache), looking up the same random keys in each.
+ */
+void benchmarkFrozen(size_t maxSize) {
+    const size_t lookups = 1000000;
+    for (size_t size = 1000; size <= maxSize; size *= 10) {
+        vector<int> sorted(size);
+        for (size_t i = 0; i < size; ++i) {
+            sorted[i] = static_cast<int>(2 * i);
+        }
+        BinarySearchTree<int> tree = BinarySearchTree<int>::fromSorted(sorted.begin(), sorted.end());
+        FrozenBinarySearchTree<int> frozen = tree.freeze();
+        vector<int> queries(lookups);
+        std::mt19937 generator(7);
+        for (int & query : queries) {
+            // Even keys are hits and odd ones misses
+            query = static_cast<int>(generator() % (2 * size));
+        }
+        string suffix = " in " + std::to_string(size) + " ints";
+
+        measure("frozen find" + suffix + " by BinarySearchTree", lookups, [&]() {
+            size_t found = 0;
+            for (int query : queries) {
+                found += tree.find(query) != nullptr;
+            }
+            return found;
+        });
+        measure("frozen find" + suffix + " by std::lower_bound", lookups, [&]() {
+            size_t found = 0;
+            for (int query : queries) {
+                auto position = std::lower_bound(sorted.begin(), sorted.end(), query);
+                found += position != sorted.end() && *position == query;
+            }
+            return found;
+        });
+        measure("frozen find" + suffix + " by FrozenBinarySearchTree", lookups, [&]() {
+            size_t found = 0;
+            for (int query : queries) {
+                found += frozen.find(query) != nullptr;
+            }
+            return found;
+        });
+    }
+}
+
+int main(int argc, char ** argv) {
+
+    size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+    cout << "n = " << n << endl;
+    benchmarkFindAndInsert<BinarySearchTree<int> >("int", makeIntKeys(n));
+    benchmarkFindAndInsert<BinarySearchTree<int, ArenaAllocator<int> > >("int arena", makeIntKeys(n));
+    benchmarkFindAndInsert<CompactBinarySearchTree<int> >("int compact", makeIntKeys(n));
+    benchmarkFindAndInsert<BTree<int> >("int btree", makeIntKeys(n));
+    benchmarkFindAndInsert<BinarySearchTree<int64_t> >("int64", makeInt64Keys(n));
+    benchmarkFindAndInsert<BTree<int64_t> >("int64 btree", makeInt64Keys(n));
+    benchmarkFindAndInsert<BinarySearchTree<string> >("string", makeStringKeys(n));
+    benchmarkFindAndInsert<BinarySearchTree<string, ArenaAllocator<string> > >("string arena", makeStringKeys(n));
+
+    benchmarkSortedLoad(n);
+    benchmarkBatch(makeIntKeys(n));
+    benchmarkSetOperations(makeIntKeys(n));
+    benchmarkSnapshot(makeIntKeys(n));
+    benchmarkWrite(makeIntKeys(n));
+    benchmarkFrozen(10 * n);
+    benchmarkCopy<BinarySearchTree<int> >("int", makeIntKeys(n));
+    benchmarkCopy<BinarySearchTree<int, ArenaAllocator<int> > >("int arena", makeIntKeys(n));
+    benchmarkScan<BinarySearchTree<int> >("int", makeIntKeys(n));
+    benchmarkScan<BinarySearchTree<int, ArenaAllocator<int> > >("int arena", makeIntKeys(n));
+    benchmarkConcurrent(n);
+    benchmarkPersistent(makeIntKeys(n));
+
+    cout << "bytes per int node: TreeNode " << sizeof(TreeNode<int>) << " + malloc overhead, CompactTreeNode "
+         << sizeof(CompactTreeNode<int>) << endl;
+
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include "btree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+using std::cout;
+using std::endl;
+using std::ostringstream;
+using std::string;
+using std::vector;
+
+/**
+ * Insert random keys, including the smallest and greatest values of the type, into a BTree and a std::set and check
+ * that the BTree finds exactly the same keys and iterates them in the same order.
+ */
+template<typename T>
+bool matchesSet(size_t n, unsigned seed) {
+    BTree<T> tree;
+    std::set<T> reference;
+    std::mt19937_64 generator(seed);
+    vector<T> keys;
+    keys.push_back(std::numeric_limits<T>::max());
+    keys.push_back(std::numeric_limits<T>::min());
+    keys.push_back(0);
+    for (size_t i = 0; i < n; ++i) {
+        T key = static_cast<T>(generator());
+        // Half of the keys near zero, so that neighbours and duplicates are common
+        keys.push_back(i % 2 ? key : static_cast<T>(key % 1000));
+    }
+    bool correct = true;
+    for (T key : keys) {
+        bool inserted = tree.insert(key) != nullptr;
+        correct = correct && inserted == reference.insert(key).second;
+    }
+    for (T key : keys) {
+        T above = key < std::numeric_limits<T>::max() ? static_cast<T>(key + 1) : key;
+        T below = std::numeric_limits<T>::min() < key ? static_cast<T>(key - 1) : key;
+        for (T probe : {key, above, below}) {
+            const T * found = tree.find(probe);
+            correct = correct && (found ? *found == probe : true) && (found != nullptr) == (reference.count(probe) == 1);
+        }
+    }
+    vector<T> was(tree.begin(), tree.end());
+    return correct && tree.size() == reference.size() && was == vector<T>(reference.begin(), reference.end());
+}
+
+int main() {
+
+    int retval = 0;
+    {
+        BTree<string> tree;
+        for (const char * animal : {"panda", "lion", "owl", "dolphin", "lion", "koala", "bat", "tiger", "ant", "eel"}) {
+            tree.insert(string(animal));
+        }
+
+        ostringstream s;
+        tree.write(s);
+
+        if (s.str() == " ant  bat  dolphin  eel  koala  lion  owl  panda  tiger " && tree.size() == 9 && tree.find("owl")
+            && !tree.find("cat") && tree.maxDepth() == 2) {
+            cout << "1) Pass: a BTree of strings splits its leaf and is written as \" ant  bat  dolphin  eel  koala  lion  owl  panda  tiger \"\n";
+        } else {
+            cout << "1) Fail: a BTree of strings should be written as \" ant  bat  dolphin  eel  koala  lion  owl  panda  tiger \" but it gives \"" << s.str() << "\"\n";
+            ++retval;
+        }
+    }
+
+    {
+        if (matchesSet<int32_t>(200000, 1) && matchesSet<uint32_t>(200000, 2) && matchesSet<int64_t>(200000, 3)
+            && matchesSet<uint64_t>(200000, 4) && matchesSet<int16_t>(20000, 5)) {
+            cout << "2) Pass: BTrees of signed and unsigned 16, 32 and 64-bit keys find and iterate the same keys as a std::set\n";
+        } else {
+            cout << "2) Fail: BTrees of signed and unsigned 16, 32 and 64-bit keys should find and iterate the same keys as a std::set\n";
+            ++retval;
+        }
+    }
+
+    {
+        BTree<int> tree;
+        const int n = 1000000;
+        for (int i = 0; i < n; ++i) {
+            tree.insert(i);
+        }
+
+        if (tree.size() == static_cast<size_t>(n) && tree.maxDepth() <= 1 + std::ceil(std::log(n) / std::log(9.0))
+            && std::is_sorted(tree.begin(), tree.end()) && *tree.find(n - 1) == n - 1) {
+            cout << "3) Pass: a BTree of a million ascending ints is " << tree.maxDepth() << " levels deep\n";
+        } else {
+            cout << "3) Fail: a BTree of a million ascending ints should be at most " << 1 + std::ceil(std::log(n) / std::log(9.0)) << " levels deep but is " << tree.maxDepth() << "\n";
+            ++retval;
+        }
+    }
+
+    {
+        BTree<string> tree;
+        for (const char * animal : {"owl", "ant", "eel", "bat"}) {
+            tree.insert(string(animal));
+        }
+
+        auto third = tree.begin();
+        ++(++third);
+        bool constData = std::is_same<decltype(*third), const string &>::value
+                         && std::is_same<decltype(tree.insert(string("cat"))), const string *>::value;
+
+        if (constData && *third == "eel" && third->size() == 3 && std::distance(tree.begin(), tree.end()) == 4) {
+            cout << "4) Pass: the BTree iterator can be chained, gives read-only data and works with std::distance\n";
+        } else {
+            cout << "4) Fail: the BTree iterator should be chainable, give read-only data and work with std::distance\n";
+            ++retval;
+        }
+    }
+
+    cout << endl;
+
+    return retval;
+
+}
@@ -0,0 +1,149 @@
+#include "compacttree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using std::cout;
+using std::endl;
+using std::ostringstream;
+using std::vector;
+
+int main() {
+
+    int retval = 0;
+    {
+        CompactBinarySearchTree<int> tree;
+
+        for (int e : {5, 1, 2, 6}) {
+            tree.insert(e);
+        }
+
+        ostringstream s;
+        tree.write(s);
+
+        if (s.str() == " 1  2  5  6 ") {
+            cout << "1) Pass: adding 5, 1, 2 and 6 to the compact tree yields the tree \" 1  2  5  6 \"\n";
+        } else {
+            cout << "1) Fail: adding 5, 1, 2 and 6 to the compact tree should yield the tree \" 1  2  5  6 \" but it gives \"" << s.str() << "\"\n";
+            ++retval;
+        }
+
+        auto six = tree.find(6);
+        auto three = tree.find(3);
+
+        if (six && *six == 6 && !three && !tree.insert(5)) {
+            cout << "2) Pass: found 6, did not find 3, and could not insert 5 twice\n";
+        } else {
+            cout << "2) Fail: should have found 6, not found 3, and refused to insert 5 twice\n";
+            ++retval;
+        }
+    }
+
+    {
+        if (sizeof(CompactTreeNode<int>) == 16) {
+            cout << "3) Pass: a compact node holding an int takes 16 bytes\n";
+        } else {
+            cout << "3) Fail: a compact node holding an int should take 16 bytes but takes " << sizeof(CompactTreeNode<int>) << "\n";
+            ++retval;
+        }
+    }
+
+    {
+        CompactBinarySearchTree<int> tree;
+        const int n = 1000000;
+
+        for (int i = 0; i < n; ++i) {
+            tree.insert(i);
+        }
+
+        int expected = 0;
+        bool inOrder = true;
+        for (int e : tree) {
+            inOrder = inOrder && e == expected++;
+        }
+
+        if (inOrder && expected == n && tree.size() == n && tree.maxDepth() <= 1.4405 * std::log2(n + 2.0)) {
+            cout << "4) Pass: after inserting 0.." << n - 1 << " in order, the compact tree iterates them in order and has depth " << tree.maxDepth() << "\n";
+        } else {
+            cout << "4) Fail: after inserting 0.." << n - 1 << " in order, the compact tree should iterate them in order and be balanced, but has depth " << tree.maxDepth() << "\n";
+            ++retval;
+        }
+    }
+
+    {
+        CompactBinarySearchTree<int> tree;
+        vector<int> putIn(200000);
+        std::mt19937 generator(42);
+
+        for (int & e : putIn) {
+            e = static_cast<int>(generator() % 1000000);
+            tree.insert(e);
+        }
+
+        std::sort(putIn.begin(), putIn.end());
+        putIn.erase(std::unique(putIn.begin(), putIn.end()), putIn.end());
+
+        vector<int> was(tree.begin(), tree.end());
+
+        if (was == putIn && tree.maxDepth() <= 1.4405 * std::log2(putIn.size() + 2.0)) {
+            cout << "5) Pass: after inserting random numbers, the compact tree iterates them sorted and has depth " << tree.maxDepth() << "\n";
+        } else {
+            cout << "5) Fail: after inserting random numbers, the compact tree should iterate them sorted and be balanced, but has depth " << tree.maxDepth() << "\n";
+            ++retval;
+        }
+    }
+
+    {
+        CompactBinarySearchTree<std::pair<int, int> > tree;
+
+        for (int e : {3, 1, 4, 2}) {
+            tree.insert(std::make_pair(e, -e));
+        }
+
+        auto third = tree.begin();
+        ++(++third);
+        bool constData = std::is_same<decltype(*third), const std::pair<int, int> &>::value;
+        auto found = std::find_if(tree.begin(), tree.end(), [](const std::pair<int, int> & e) { return e.second == -2; });
+
+        if (constData && third->first == 3 && found != tree.end() && found->first == 2
+            && std::distance(tree.begin(), tree.end()) == 4) {
+            cout << "6) Pass: the compact tree iterator can be chained, gives read-only data and works with std::find_if and std::distance\n";
+        } else {
+            cout << "6) Fail: the compact tree iterator should be chainable, give read-only data and work with std::find_if and std::distance\n";
+            ++retval;
+        }
+    }
+
+    {
+        CompactBinarySearchTree<int> tree;
+
+        for (int e : {7, 3, 9, 1}) {
+            tree.insert(e);
+        }
+
+        const CompactBinarySearchTree<int> & constTree = tree;
+        bool readOnly = std::is_same<decltype(tree.insert(5)), const int *>::value
+                        && std::is_same<decltype(constTree.find(3)), const int *>::value
+                        && std::is_same<decltype(constTree.begin().getNode()), const CompactTreeNode<int> *>::value;
+        const int * nine = constTree.find(9);
+        vector<int> was(constTree.begin(), constTree.end());
+
+        if (readOnly && nine && *nine == 9 && !constTree.find(4) && was == vector<int>({1, 3, 7, 9})) {
+            cout << "7) Pass: a const compact tree can be searched and iterated, and insert and find give read-only elements\n";
+        } else {
+            cout << "7) Fail: a const compact tree should be searchable and iterable, and insert and find should give read-only elements\n";
+            ++retval;
+        }
+    }
+
+    cout << endl;
+
+    return retval;
+
+}
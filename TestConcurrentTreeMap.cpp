@@ -0,0 +1,264 @@
+#include "concurrenttreemap.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::cout;
+using std::endl;
+using std::ostringstream;
+using std::string;
+using std::vector;
+
+/**
+ * Value of 256 bytes that counts how often it is copied.
+ */
+struct CountedValue {
+
+    static int copies;
+
+    char payload[256];
+
+    CountedValue() {
+    }
+
+    CountedValue(const CountedValue & other) {
+        ++copies;
+        std::copy(other.payload, other.payload + sizeof(payload), payload);
+    }
+
+    CountedValue(CountedValue &&) = default;
+};
+
+int CountedValue::copies = 0;
+
+/**
+ * Key that counts its live instances and throws from its copy constructor once a copy limit is hit.
+ */
+struct ThrowingKey {
+
+    static int alive;
+    static int copiesLeft;
+
+    int value;
+
+    explicit ThrowingKey(int valueIn)
+        : value(valueIn) {
+        ++alive;
+    }
+
+    ThrowingKey(const ThrowingKey & other)
+        : value(other.value) {
+        if (--copiesLeft < 0) {
+            throw std::runtime_error("copy limit reached");
+        }
+        ++alive;
+    }
+
+    ~ThrowingKey() {
+        --alive;
+    }
+
+    bool operator<(const ThrowingKey & other) const {
+        return value < other.value;
+    }
+};
+
+int ThrowingKey::alive = 0;
+int ThrowingKey::copiesLeft = 1 << 30;
+
+
+int main() {
+
+    int retval = 0;
+    {
+        ConcurrentTreeMap<int, string> map;
+        map.insert(5, "panda");
+        map.insert(1, "lion");
+        map.insert(2, "dolphin");
+        bool duplicate = map.insert(5, "koala");
+        map.insert_or_assign(1, "tiger");
+        bool erased = map.erase(2);
+
+        string found;
+        size_t length = 0;
+        ostringstream s;
+        map.forEach([&](const KeyValuePair<int, string> & pair) { s << pair << " "; });
+
+        if (!duplicate && erased && map.find(5, found) && found == "panda" && !map.find(2, found)
+            && map.visit(1, [&](const string & v) { length = v.size(); }) && length == 5
+            && map.size() == 2 && s.str() == "1,tiger 5,panda ") {
+            cout << "1) Pass: a ConcurrentTreeMap inserts, assigns, erases and finds like a TreeMap\n";
+        } else {
+            cout << "1) Fail: a ConcurrentTreeMap should insert, assign, erase and find like a TreeMap but it gives \"" << s.str() << "\"\n";
+            ++retval;
+        }
+    }
+
+    {
+        ConcurrentTreeMap<int, int> map;
+        std::set<int> reference;
+        std::mt19937 generator(11);
+        for (int i = 0; i < 200000; ++i) {
+            int key = static_cast<int>(generator() % 50000);
+            if (generator() % 3 == 0) {
+                map.erase(key);
+                reference.erase(key);
+            } else {
+                map.insert(key, key);
+                reference.insert(key);
+            }
+        }
+
+        vector<int> was;
+        map.forEach([&](const KeyValuePair<int, int> & pair) { was.push_back(pair.k); });
+
+        if (was == vector<int>(reference.begin(), reference.end()) && map.size() == reference.size()
+            && map.maxDepth() <= 1.4405 * std::log2(reference.size() + 2.0)) {
+            cout << "2) Pass: after random inserts and erases the ConcurrentTreeMap holds the right Keys and has depth " << map.maxDepth() << "\n";
+        } else {
+            cout << "2) Fail: after random inserts and erases the ConcurrentTreeMap should hold the right Keys and be balanced, but has depth " << map.maxDepth() << "\n";
+            ++retval;
+        }
+    }
+
+    {
+        ConcurrentTreeMap<int, int> map;
+        const int stable = 1000;
+        for (int i = 0; i < stable; ++i) {
+            map.insert(i, 2 * i);
+        }
+
+        std::atomic<bool> writing(true);
+        std::atomic<int> errors(0);
+        vector<std::thread> readers;
+        for (int r = 0; r < 4; ++r) {
+            readers.push_back(std::thread([&, r]() {
+                std::mt19937 generator(r);
+                while (writing.load()) {
+                    int key = static_cast<int>(generator() % stable);
+                    int value = -1;
+                    if (!map.find(key, value) || value != 2 * key) {
+                        ++errors;
+                    }
+                    int previous = -1;
+                    size_t seen = 0;
+                    map.forEach([&](const KeyValuePair<int, int> & pair) {
+                        if (pair.k <= previous) {
+                            ++errors;
+                        }
+                        previous = pair.k;
+                        seen += pair.k < stable;
+                    });
+                    if (seen != static_cast<size_t>(stable)) {
+                        ++errors;
+                    }
+                }
+            }));
+        }
+
+        std::mt19937 generator(3);
+        for (int i = 0; i < 100000; ++i) {
+            int key = stable + static_cast<int>(generator() % 2000);
+            if (i % 2) {
+                map.insert(key, 2 * key);
+            } else {
+                map.erase(key);
+            }
+            int replaced = static_cast<int>(generator() % stable);
+            map.insert_or_assign(replaced, 2 * replaced);
+        }
+        writing.store(false);
+        for (std::thread & reader : readers) {
+            reader.join();
+        }
+
+        int value = -1;
+        bool correct = true;
+        for (int i = 0; i < stable; ++i) {
+            correct = correct && map.find(i, value) && value == 2 * i;
+        }
+
+        if (correct && errors.load() == 0) {
+            cout << "3) Pass: four readers always see a complete, sorted ConcurrentTreeMap while a writer changes it\n";
+        } else {
+            cout << "3) Fail: four readers should always see a complete, sorted ConcurrentTreeMap while a writer changes it, but saw " << errors.load() << " errors\n";
+            ++retval;
+        }
+    }
+
+    {
+        ConcurrentTreeMap<int, CountedValue> map;
+        CountedValue value;
+        for (int i = 0; i < 10000; ++i) {
+            map.insert(i, value);
+        }
+        CountedValue::copies = 0;
+        for (int i = 10000; i < 11000; ++i) {
+            map.insert(i, value);
+        }
+        int insertCopies = CountedValue::copies;
+        CountedValue::copies = 0;
+        for (int i = 0; i < 1000; ++i) {
+            map.erase(i);
+        }
+        int eraseCopies = CountedValue::copies;
+
+        if (insertCopies == 1000 && eraseCopies == 0 && map.size() == 10000) {
+            cout << "4) Pass: a big Value is copied once per insert and never when a writer copies the path to it\n";
+        } else {
+            cout << "4) Fail: a big Value should be copied once per insert and never when a writer copies a path, but 1000 inserts made " << insertCopies << " copies and 1000 erases " << eraseCopies << "\n";
+            ++retval;
+        }
+    }
+
+    {
+        ConcurrentTreeMap<ThrowingKey, int> map;
+        for (int i = 0; i < 1000; ++i) {
+            map.insert(ThrowingKey(2 * i), i);
+        }
+        int aliveBefore = ThrowingKey::alive;
+        int failed = 0;
+
+        // Every write copies a path of about ten TreeNodes, so it throws after having made a few copies
+        for (int copies : {0, 3, 6}) {
+            ThrowingKey::copiesLeft = copies;
+            try {
+                map.insert(ThrowingKey(999), 0);
+            } catch (const std::runtime_error &) {
+                ++failed;
+            }
+            ThrowingKey::copiesLeft = copies;
+            try {
+                map.erase(ThrowingKey(1000));
+            } catch (const std::runtime_error &) {
+                ++failed;
+            }
+        }
+        ThrowingKey::copiesLeft = 1 << 30;
+
+        int expected = 0;
+        bool inOrder = true;
+        map.forEach([&](const KeyValuePair<ThrowingKey, int> & pair) { inOrder = inOrder && pair.k.value == 2 * expected++; });
+
+        if (failed == 6 && ThrowingKey::alive == aliveBefore && inOrder && expected == 1000 && map.size() == 1000) {
+            cout << "5) Pass: writes that throw halfway leave the ConcurrentTreeMap as it was and free the TreeNodes they copied\n";
+        } else {
+            cout << "5) Fail: writes that throw halfway should leave the ConcurrentTreeMap as it was and free the TreeNodes they copied, but " << ThrowingKey::alive - aliveBefore << " Keys are left over\n";
+            ++retval;
+        }
+    }
+
+    cout << endl;
+
+    return retval;
+
+}
@@ -0,0 +1,95 @@
+#include "treemap.h"
+#include "frozentree.h"
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using std::cout;
+using std::endl;
+using std::ostringstream;
+using std::string;
+using std::vector;
+
+int main() {
+
+    int retval = 0;
+    {
+        BinarySearchTree<int> tree;
+        for (int e : {40, 20, 10, 50, 30}) {
+            tree.insert(e);
+        }
+        FrozenBinarySearchTree<int> frozen = tree.freeze();
+        tree.insert(60);
+
+        ostringstream s;
+        frozen.write(s);
+
+        if (s.str() == " 10  20  30  40  50 " && frozen.size() == 5 && frozen.find(30) && *frozen.find(30) == 30
+            && !frozen.find(35) && !frozen.find(60) && *frozen.lower_bound(35) == 40 && *frozen.lower_bound(0) == 10
+            && !frozen.lower_bound(51)) {
+            cout << "1) Pass: the frozen tree \" 10  20  30  40  50 \" finds its elements and lower bounds, and does not change with the tree\n";
+        } else {
+            cout << "1) Fail: the frozen tree should be \" 10  20  30  40  50 \" and find its elements, but it is \"" << s.str() << "\"\n";
+            ++retval;
+        }
+    }
+
+    {
+        bool correct = true;
+        std::mt19937 generator(21);
+        for (size_t n : {0u, 1u, 2u, 3u, 7u, 8u, 9u, 1000u, 65535u, 65536u, 100001u}) {
+            std::set<int> reference;
+            while (reference.size() < n) {
+                reference.insert(static_cast<int>(generator() % (4 * n)) * 2);
+            }
+            vector<int> sorted(reference.begin(), reference.end());
+            BinarySearchTree<int> tree = BinarySearchTree<int>::fromSorted(sorted.begin(), sorted.end());
+            FrozenBinarySearchTree<int> frozen = tree.freeze();
+
+            vector<int> was;
+            frozen.forEach([&](int e) { was.push_back(e); });
+            correct = correct && was == sorted && frozen.size() == n;
+            for (int key = -1; key <= static_cast<int>(8 * n) + 1; key += n > 1000 ? 7 : 1) {
+                auto expected = std::lower_bound(sorted.begin(), sorted.end(), key);
+                const int * found = frozen.lower_bound(key);
+                correct = correct && (expected == sorted.end() ? !found : found && *found == *expected)
+                          && (frozen.find(key) != nullptr) == (reference.count(key) == 1);
+            }
+        }
+
+        if (correct) {
+            cout << "2) Pass: frozen trees of 0 to 100001 random elements iterate in order and agree with std::lower_bound for every key\n";
+        } else {
+            cout << "2) Fail: frozen trees of 0 to 100001 random elements should iterate in order and agree with std::lower_bound for every key\n";
+            ++retval;
+        }
+    }
+
+    {
+        TreeMap<int, string> tree;
+        tree.insert(5, "panda");
+        tree.insert(1, "lion");
+        tree.insert(8, "owl");
+        FrozenBinarySearchTree<KeyValuePair<int, string> > frozen = tree.freeze();
+
+        const KeyValuePair<int, string> * owl = frozen.find(8);
+        const KeyValuePair<int, string> * next = frozen.lower_bound(2);
+
+        if (owl && owl->v == "owl" && next && next->v == "panda" && !frozen.find(2)) {
+            cout << "3) Pass: a frozen TreeMap finds the Value of a Key and the first Key not smaller than 2\n";
+        } else {
+            cout << "3) Fail: a frozen TreeMap should find the Value of a Key and the first Key not smaller than 2\n";
+            ++retval;
+        }
+    }
+
+    cout << endl;
+
+    return retval;
+
+}
@@ -0,0 +1,134 @@
+#include "mappedtreemap.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using std::cout;
+using std::endl;
+using std::ostringstream;
+using std::string;
+using std::stringstream;
+using std::vector;
+
+int main() {
+
+    int retval = 0;
+    {
+        TreeMap<int, double> tree;
+        tree.insert(5, 0.5);
+        tree.insert(1, 0.1);
+        tree.insert(8, 0.8);
+
+        stringstream snapshot;
+        bool written = tree.writeBinary(snapshot);
+        TreeMap<int, double> loaded;
+        loaded.insert(3, 0.3);
+        bool read = loaded.readBinary(snapshot);
+
+        ostringstream s;
+        loaded.write(s);
+
+        if (written && read && loaded.size() == 3 && s.str() == " 1,0.1  5,0.5  8,0.8 ") {
+            cout << "1) Pass: a TreeMap read back from its binary snapshot yields \" 1,0.1  5,0.5  8,0.8 \"\n";
+        } else {
+            cout << "1) Fail: a TreeMap read back from its binary snapshot should yield \" 1,0.1  5,0.5  8,0.8 \" but it gives \"" << s.str() << "\"\n";
+            ++retval;
+        }
+    }
+
+    {
+        const char * path = "TestMappedTreeMap.bin";
+        TreeMap<long long, int> tree;
+        std::mt19937 generator(19);
+        vector<long long> keys;
+        for (int i = 0; i < 100000; ++i) {
+            long long key = static_cast<long long>(generator()) * 3;
+            if (tree.insert(key, i)) {
+                keys.push_back(key);
+            }
+        }
+        {
+            std::ofstream out(path, std::ios::binary);
+            tree.writeBinary(out);
+        }
+
+        MappedTreeMap<long long, int> mapped;
+        bool opened = mapped.open(path);
+        bool correct = opened && mapped.size() == tree.size();
+        for (long long key : keys) {
+            const int * value = mapped.find(key);
+            correct = correct && value && *value == tree.find(key)->v && !mapped.find(key + 1);
+        }
+        long long previous = -1;
+        mapped.forEach([&](const long long & key, const int &) {
+            correct = correct && previous < key;
+            previous = key;
+        });
+        mapped.close();
+        std::remove(path);
+
+        if (correct && !mapped.isOpen() && !mapped.find(keys[0])) {
+            cout << "2) Pass: a MappedTreeMap over the snapshot of 100000 random Keys finds every Key and nothing else\n";
+        } else {
+            cout << "2) Fail: a MappedTreeMap over the snapshot of 100000 random Keys should find every Key and nothing else\n";
+            ++retval;
+        }
+    }
+
+    {
+        const char * path = "TestMappedTreeMap.bin";
+        TreeMap<int, int> tree;
+        for (int i = 0; i < 1000; ++i) {
+            tree.insert(i, i);
+        }
+        stringstream snapshot;
+        tree.writeBinary(snapshot);
+        string full = snapshot.str();
+
+        stringstream truncated(full.substr(0, full.size() - 1));
+        TreeMap<int, int> fromTruncated;
+        bool readTruncated = fromTruncated.readBinary(truncated);
+
+        string unsorted = full;
+        std::swap(unsorted[sizeof(TreeMapFileHeader)], unsorted[sizeof(TreeMapFileHeader) + 3 * sizeof(int)]);
+        stringstream outOfOrder(unsorted);
+        TreeMap<int, int> fromOutOfOrder;
+        bool readOutOfOrder = fromOutOfOrder.readBinary(outOfOrder);
+
+        stringstream wrongType(full);
+        TreeMap<int, double> fromWrongType;
+        bool readWrongType = fromWrongType.readBinary(wrongType);
+
+        {
+            std::ofstream out(path, std::ios::binary);
+            out.write(full.data(), static_cast<std::streamsize>(full.size() - 1));
+        }
+        MappedTreeMap<int, int> mapped;
+        bool opened = mapped.open(path);
+        {
+            std::ofstream out(path, std::ios::binary);
+            out.write(unsorted.data(), static_cast<std::streamsize>(unsorted.size()));
+        }
+        bool openedOutOfOrder = mapped.open(path);
+        std::remove(path);
+        bool openedMissing = mapped.open(path);
+
+        if (!readTruncated && !readOutOfOrder && !readWrongType && fromTruncated.size() == 0 && !opened
+            && !openedOutOfOrder && !openedMissing && !mapped.isOpen()) {
+            cout << "3) Pass: truncated, out of order and mistyped snapshots and missing files are rejected\n";
+        } else {
+            cout << "3) Fail: truncated, out of order and mistyped snapshots and missing files should be rejected\n";
+            ++retval;
+        }
+    }
+
+    cout << endl;
+
+    return retval;
+
+}
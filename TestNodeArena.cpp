@@ -0,0 +1,138 @@
+#include "nodearena.h"
+#include "tree.h"
+#include "treemap.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using std::cout;
+using std::endl;
+using std::ostringstream;
+using std::string;
+
+int main() {
+
+    int retval = 0;
+    {
+        NodeArena arena;
+
+        void * first = arena.allocate(32);
+        void * second = arena.allocate(32);
+
+        if (static_cast<char *>(second) - static_cast<char *>(first) == 32) {
+            cout << "1) Pass: two 32 byte allocations from an arena are next to each other\n";
+        } else {
+            cout << "1) Fail: two 32 byte allocations from an arena should be 32 bytes apart but are " << static_cast<char *>(second) - static_cast<char *>(first) << " bytes apart\n";
+            ++retval;
+        }
+
+        arena.deallocate(first, 32);
+        void * third = arena.allocate(32);
+
+        if (third == first) {
+            cout << "2) Pass: an allocation after a deallocation of the same size reuses the freed slot\n";
+        } else {
+            cout << "2) Fail: an allocation after a deallocation of the same size should reuse the freed slot\n";
+            ++retval;
+        }
+    }
+
+    {
+        ArenaAllocator<int> allocator;
+        BinarySearchTree<int, ArenaAllocator<int> > tree(allocator);
+
+        for (int i = 0; i < 10000; ++i) {
+            tree.insert(i);
+        }
+        for (int i = 0; i < 10000; i += 2) {
+            tree.erase(i);
+        }
+
+        size_t blocks = allocator.getArena().blockCount();
+
+        for (int i = 0; i < 10000; i += 2) {
+            tree.insert(i);
+        }
+
+        bool found = true;
+        for (int i = 0; i < 10000; ++i) {
+            found = found && tree.find(i);
+        }
+
+        if (found && tree.maxDepth() <= 14 && allocator.getArena().blockCount() == blocks) {
+            cout << "3) Pass: a tree using an arena finds all of 0..9999 after erasing and reinserting the even ones, without taking new blocks\n";
+        } else {
+            cout << "3) Fail: a tree using an arena should find all of 0..9999 after erasing and reinserting the even ones, reusing freed nodes\n";
+            ++retval;
+        }
+    }
+
+    {
+        TreeMap<int, string, ArenaAllocator<KeyValuePair<int, string> > > map;
+
+        map.insert(5, "panda");
+        map.insert(1, "lion");
+        map.insert(2, "dolphin");
+        map.erase(1);
+
+        ostringstream s;
+        map.write(s);
+
+        if (s.str() == " 2,dolphin  5,panda ") {
+            cout << "4) Pass: a TreeMap using an arena yields \" 2,dolphin  5,panda \" after inserting three pairs and erasing one\n";
+        } else {
+            cout << "4) Fail: a TreeMap using an arena should yield \" 2,dolphin  5,panda \" but it gives \"" << s.str() << "\"\n";
+            ++retval;
+        }
+    }
+
+    {
+        ArenaAllocator<int> allocator;
+        BinarySearchTree<int, ArenaAllocator<int> > longLived(allocator);
+        longLived.insert(0);
+
+        size_t blocks = 0;
+        for (int round = 0; round < 100; ++round) {
+            BinarySearchTree<int, ArenaAllocator<int> > shortLived(allocator);
+            for (int i = 0; i < 10000; ++i) {
+                shortLived.insert(i);
+            }
+            if (round == 0) {
+                blocks = allocator.getArena().blockCount();
+            }
+        }
+
+        if (allocator.getArena().blockCount() == blocks) {
+            cout << "5) Pass: trees created and destroyed 100 times on an arena shared with a long-lived tree reuse the same " << blocks << " blocks\n";
+        } else {
+            cout << "5) Fail: trees created and destroyed on an arena shared with a long-lived tree should reuse their nodes, but the arena grew from " << blocks << " to " << allocator.getArena().blockCount() << " blocks\n";
+            ++retval;
+        }
+    }
+
+    {
+        BinarySearchTree<int, ArenaAllocator<int> > tree;
+        for (int i = 0; i < 100; ++i) {
+            tree.insert(i);
+        }
+        TreeNode<int> standalone(7);
+
+        bool marked = true;
+        for (auto it = tree.begin(); it != tree.end(); ++it) {
+            marked = marked && tree.find(*it)->fromAllocator;
+        }
+
+        if (marked && !standalone.fromAllocator) {
+            cout << "6) Pass: the nodes of a tree are marked as coming from its allocator, so that their unique_ptrs never delete them\n";
+        } else {
+            cout << "6) Fail: the nodes of a tree should be marked as coming from its allocator, and only them\n";
+            ++retval;
+        }
+    }
+
+    cout << endl;
+
+    return retval;
+
+}
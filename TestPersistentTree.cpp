@@ -0,0 +1,134 @@
+#include "persistenttree.h"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using std::cout;
+using std::endl;
+using std::ostringstream;
+using std::string;
+using std::vector;
+
+/**
+ * An int that counts how many of its kind are alive, to check that dropped versions free their TreeNodes.
+ */
+class CountedInt {
+
+public:
+
+    static int alive;
+    int x;
+
+    CountedInt(int xIn)
+            : x(xIn) {
+        ++alive;
+    }
+
+    CountedInt(const CountedInt & other)
+            : x(other.x) {
+        ++alive;
+    }
+
+    ~CountedInt() {
+        --alive;
+    }
+
+    bool operator<(const CountedInt & other) const {
+        return x < other.x;
+    }
+
+};
+
+int CountedInt::alive = 0;
+
+int main() {
+
+    int retval = 0;
+    {
+        PersistentBinarySearchTree<int> empty;
+        PersistentBinarySearchTree<int> first = empty.insert(5).insert(1).insert(2);
+        PersistentBinarySearchTree<int> second = first.insert(6).erase(1);
+        PersistentBinarySearchTree<int> same = second.insert(6);
+
+        ostringstream s1, s2, s3;
+        empty.write(s1);
+        first.write(s2);
+        second.write(s3);
+
+        if (s1.str().empty() && s2.str() == " 1  2  5 " && s3.str() == " 2  5  6 " && same.sharesRootWith(second)
+            && first.find(1) && !second.find(1) && second.size() == 3) {
+            cout << "1) Pass: inserting and erasing gives new versions \" 1  2  5 \" and \" 2  5  6 \" and leaves the old ones as they were\n";
+        } else {
+            cout << "1) Fail: inserting and erasing should give new versions \" 1  2  5 \" and \" 2  5  6 \" but they are \"" << s2.str() << "\" and \"" << s3.str() << "\"\n";
+            ++retval;
+        }
+    }
+
+    {
+        PersistentBinarySearchTree<int> tree;
+        std::set<int> reference;
+        vector<PersistentBinarySearchTree<int> > snapshots;
+        vector<std::set<int> > expected;
+        std::mt19937 generator(21);
+
+        for (int i = 0; i < 100000; ++i) {
+            int key = static_cast<int>(generator() % 20000);
+            if (generator() % 3 == 0) {
+                tree = tree.erase(key);
+                reference.erase(key);
+            } else {
+                tree = tree.insert(key);
+                reference.insert(key);
+            }
+            if (i % 10000 == 0) {
+                snapshots.push_back(tree.snapshot());
+                expected.push_back(reference);
+            }
+        }
+
+        bool correct = tree.size() == reference.size() && tree.maxDepth() <= 1.4405 * std::log2(reference.size() + 2.0);
+        for (size_t i = 0; i < snapshots.size() && correct; ++i) {
+            vector<int> was;
+            snapshots[i].forEach([&](int e) { was.push_back(e); });
+            correct = was == vector<int>(expected[i].begin(), expected[i].end()) && snapshots[i].size() == was.size();
+        }
+
+        if (correct) {
+            cout << "2) Pass: snapshots taken during random inserts and erases keep their elements, and the tree has depth " << tree.maxDepth() << "\n";
+        } else {
+            cout << "2) Fail: snapshots taken during random inserts and erases should keep their elements and the tree be balanced, but it has depth " << tree.maxDepth() << "\n";
+            ++retval;
+        }
+    }
+
+    {
+        int aliveWithOneVersion = 0;
+        int aliveWithTwoVersions = 0;
+        {
+            PersistentBinarySearchTree<CountedInt> tree;
+            for (int i = 0; i < 1000; ++i) {
+                tree = tree.insert(CountedInt(i));
+            }
+            aliveWithOneVersion = CountedInt::alive;
+            PersistentBinarySearchTree<CountedInt> changed = tree.insert(CountedInt(1000));
+            aliveWithTwoVersions = CountedInt::alive;
+        }
+
+        if (aliveWithOneVersion == 1000 && aliveWithTwoVersions - aliveWithOneVersion <= 2 * 11 && CountedInt::alive == 0) {
+            cout << "3) Pass: a new version of a 1000 element tree copies only the path, and dropping the versions frees every element\n";
+        } else {
+            cout << "3) Fail: a new version of a 1000 element tree should copy only the path (it added " << aliveWithTwoVersions - aliveWithOneVersion << " elements), and dropping the versions should free every element\n";
+            ++retval;
+        }
+    }
+
+    cout << endl;
+
+    return retval;
+
+}
@@ -1,8 +1,12 @@
 #include "treenode.h"
 #include "tree.h"
 
+#include <cctype>
+#include <functional>
+#include <iomanip>
 #include <iostream>
 #include <sstream> 
+#include <string>
 
 using std::cout;
 using std::endl;
@@ -10,6 +14,43 @@ using std::ostringstream;
 
 
 
+/**
+ * Case-insensitive ordering of strings that counts how often each of its forms is used.
+ */
+class CaseInsensitive {
+    
+public:
+    
+    static int lessCalls;
+    static int compareCalls;
+    
+    bool operator()(const std::string & a, const std::string & b) const {
+        ++lessCalls;
+        return compareIgnoringCase(a, b) < 0;
+    }
+    
+    int compare(const std::string & a, const std::string & b) const {
+        ++compareCalls;
+        return compareIgnoringCase(a, b);
+    }
+    
+private:
+    
+    static int compareIgnoringCase(const std::string & a, const std::string & b) {
+        for (size_t i = 0; i < a.size() && i < b.size(); ++i) {
+            int difference = std::tolower(static_cast<unsigned char>(a[i])) - std::tolower(static_cast<unsigned char>(b[i]));
+            if (difference != 0) {
+                return difference;
+            }
+        }
+        return a.size() < b.size() ? -1 : (b.size() < a.size() ? 1 : 0);
+    }
+};
+
+int CaseInsensitive::lessCalls = 0;
+int CaseInsensitive::compareCalls = 0;
+
+
 class JustAnInt {
     
 public:
@@ -22,6 +63,59 @@ public:
 };
 
 
+/**
+ * Ordered by operator<, with an unrelated compare member that must not be used to order it.
+ */
+class Revision {
+    
+public:
+    
+    int number;
+    
+    bool operator<(const Revision & other) const {
+        return number < other.number;
+    }
+    
+    bool compare(const Revision & other) const {
+        return number != other.number;
+    }
+};
+
+
+/**
+ * Plain less-than ordering whose compare member is a less-than predicate too, not a three-way comparison.
+ */
+class LessNamedCompare {
+    
+public:
+    
+    bool operator()(int a, int b) const {
+        return a < b;
+    }
+    
+    bool compare(int a, int b) const {
+        return a < b;
+    }
+};
+
+
+/**
+ * Three-way ordering of long long keys whose compare member returns the difference, which does not fit in an int.
+ */
+class Difference {
+    
+public:
+    
+    bool operator()(long long a, long long b) const {
+        return a < b;
+    }
+    
+    long long compare(long long a, long long b) const {
+        return a - b;
+    }
+};
+
+
 int main() {
     
     int retval = 0;
@@ -87,6 +181,265 @@ int main() {
         
     }         
 
+    {
+        BinarySearchTree<int> tree;
+        
+        for (int e : {5, 1, 2, 6, 3}) {
+            tree.insert(e);
+        }
+        
+        {
+            bool erased = tree.erase(2);
+            ostringstream s;
+            tree.write(s);
+            
+            if (erased && s.str() == " 1  3  5  6 " && !tree.find(2)) {
+                cout << "5) Pass: erasing 2 from the tree \" 1  2  3  5  6 \" yields the tree \" 1  3  5  6 \"\n";
+            } else {
+                cout << "5) Fail: erasing 2 from the tree \" 1  2  3  5  6 \" should yield the tree \" 1  3  5  6 \" but it gives \"" << s.str() << "\"\n";
+                ++retval;
+            }
+        }
+        
+        {
+            bool erased = tree.erase(4);
+            ostringstream s;
+            tree.write(s);
+            
+            if (!erased && s.str() == " 1  3  5  6 ") {
+                cout << "6) Pass: erasing 4, which is not in the tree, leaves the tree unchanged\n";
+            } else {
+                cout << "6) Fail: erasing 4, which is not in the tree, should leave the tree \" 1  3  5  6 \" but it gives \"" << s.str() << "\"\n";
+                ++retval;
+            }
+        }
+        
+        {
+            auto next = tree.erase(TreeNodeIterator<int>(tree.find(3)));
+            ostringstream s;
+            tree.write(s);
+            
+            if (next.getNode() && *next == 5 && s.str() == " 1  5  6 ") {
+                cout << "7) Pass: erasing the iterator pointing to 3 yields the tree \" 1  5  6 \" and an iterator pointing to 5\n";
+            } else {
+                cout << "7) Fail: erasing the iterator pointing to 3 should yield the tree \" 1  5  6 \" but it gives \"" << s.str() << "\"\n";
+                ++retval;
+            }
+        }
+    }
+
+    
+    {
+        BinarySearchTree<int> empty;
+        BinarySearchTree<int> copy(empty);
+        BinarySearchTree<int> tree;
+        tree.insert(3);
+        tree = empty;
+        
+        if (copy.begin() == copy.end() && tree.begin() == tree.end()) {
+            cout << "8) Pass: copying an empty tree, and assigning an empty tree, yields empty trees\n";
+        } else {
+            cout << "8) Fail: copying an empty tree, and assigning an empty tree, should yield empty trees\n";
+            ++retval;
+        }
+    }
+    
+    {
+        BinarySearchTree<int> tree;
+        for (int e : {5, 1, 2, 6, 3}) {
+            tree.insert(e);
+        }
+        
+        BinarySearchTree<int> copy(tree);
+        BinarySearchTree<int> assigned;
+        assigned.insert(42);
+        assigned = tree;
+        tree.erase(5);
+        
+        ostringstream s1, s2;
+        copy.write(s1);
+        assigned.write(s2);
+        
+        if (s1.str() == " 1  2  3  5  6 " && s2.str() == " 1  2  3  5  6 " && copy.maxDepth() == 3 && copy.find(5) != tree.find(5)) {
+            cout << "9) Pass: a copied and an assigned tree keep \" 1  2  3  5  6 \" after the original loses 5\n";
+        } else {
+            cout << "9) Fail: a copied and an assigned tree should keep \" 1  2  3  5  6 \" after the original loses 5 but they give \"" << s1.str() << "\" and \"" << s2.str() << "\"\n";
+            ++retval;
+        }
+    }
+    
+    {
+        BinarySearchTree<std::string> tree;
+        tree.emplace(3, 'c');
+        tree.emplace(1, 'a');
+        auto duplicate = tree.emplace("ccc");
+        
+        BinarySearchTree<std::string> moved;
+        moved.insert("zzz");
+        moved = std::move(tree);
+        
+        ostringstream s1, s2;
+        moved.write(s1);
+        tree.write(s2);
+        
+        if (!duplicate && s1.str() == " a  ccc " && s2.str().empty()) {
+            cout << "10) Pass: emplacing strings constructs them in place and move assignment takes them over\n";
+        } else {
+            cout << "10) Fail: emplacing strings and move assigning the tree should yield \" a  ccc \" but it gives \"" << s1.str() << "\"\n";
+            ++retval;
+        }
+    }
+    
+    {
+        BinarySearchTree<int> tree;
+        for (int e : {10, 20, 30, 40, 50}) {
+            tree.insert(e);
+        }
+        
+        auto equal = tree.equal_range(30);
+        auto missing = tree.equal_range(35);
+        auto between = tree.range(15, 45);
+        auto empty = tree.range(45, 15);
+        
+        if (tree.lower_bound(20).getNode()->data == 20 && tree.upper_bound(20).getNode()->data == 30
+            && tree.lower_bound(5).getNode()->data == 10 && tree.lower_bound(55) == tree.end()
+            && equal.first.getNode()->data == 30 && equal.second.getNode()->data == 40
+            && missing.first == missing.second && missing.first.getNode()->data == 40
+            && between.size() == 3 && *between.begin() == 20 && between.end().getNode()->data == 50
+            && empty.empty() && empty.begin() == empty.end()) {
+            cout << "11) Pass: in the tree \" 10  20  30  40  50 \" the bounds are found and [15, 45) holds 20, 30 and 40\n";
+        } else {
+            cout << "11) Fail: in the tree \" 10  20  30  40  50 \" the bounds should be found and [15, 45) should hold 20, 30 and 40\n";
+            ++retval;
+        }
+    }
+    
+    {
+        BinarySearchTree<int> tree;
+        for (int e : {4, 2, 8, 6, 10, 5}) {
+            tree.insert(e);
+        }
+        
+        ostringstream forwards, backwards;
+        for (int e : tree) {
+            forwards << e << " ";
+        }
+        for (auto itr = tree.end(); itr != tree.begin();) {
+            --itr;
+            backwards << *itr << " ";
+        }
+        BinarySearchTree<int> empty;
+        auto emptyEnd = empty.end();
+        --emptyEnd;
+        
+        if (forwards.str() == "2 4 5 6 8 10 " && backwards.str() == "10 8 6 5 4 2 " && emptyEnd == empty.end()) {
+            cout << "12) Pass: the tree with 4, 2, 8, 6, 10 and 5 is iterated as \"2 4 5 6 8 10 \" and backwards as \"10 8 6 5 4 2 \", --end() of an empty tree stays at the end\n";
+        } else {
+            cout << "12) Fail: the tree with 4, 2, 8, 6, 10 and 5 should be iterated as \"2 4 5 6 8 10 \" but gives \"" << forwards.str() << "\" and backwards \"" << backwards.str() << "\"\n";
+            ++retval;
+        }
+    }
+    
+    {
+        BinarySearchTree<int> tree;
+        for (int e : {40, -20, 10, 50, 30, 0}) {
+            tree.insert(e);
+        }
+        
+        ostringstream all, hex, padded, range;
+        tree.write(all, ", ");
+        hex << std::hex;
+        tree.write(hex, "|");
+        padded << std::setfill('0') << std::setw(3);
+        tree.write(padded, ",");
+        tree.writeRange(range, 5, 45, "\n", [](BufferedSink & sink, int e) {
+            sink.append('<');
+            sink.appendValue(e * 2);
+            sink.append('>');
+        });
+        
+        if (all.str() == "-20, 0, 10, 30, 40, 50" && hex.str() == "ffffffec|0|a|1e|28|32" && range.str() == "<20>\n<60>\n<80>"
+            && padded.str() == "-20,000,010,030,040,050" && padded.width() == 0) {
+            cout << "13) Pass: the tree is written as \"-20, 0, 10, 30, 40, 50\", in hex, padded to a width and with a formatter for [5, 45)\n";
+        } else {
+            cout << "13) Fail: the tree should be written as \"-20, 0, 10, 30, 40, 50\" but gives \"" << all.str() << "\", \"" << hex.str() << "\", \"" << padded.str() << "\" and \"" << range.str() << "\"\n";
+            ++retval;
+        }
+    }
+    
+    {
+        BinarySearchTree<int, std::allocator<int>, std::greater<int> > descending;
+        for (int i : {30, 10, 50, 20, 40}) {
+            descending.insert(i);
+        }
+        descending.erase(20);
+        
+        BinarySearchTree<std::string, std::allocator<std::string>, CaseInsensitive> words;
+        for (const char * word : {"Panda", "lion", "OWL", "bat", "Tiger", "dolphin", "Eel"}) {
+            words.insert(word);
+        }
+        bool duplicate = words.insert("PANDA") != nullptr;
+        CaseInsensitive::lessCalls = 0;
+        CaseInsensitive::compareCalls = 0;
+        TreeNode<std::string> * owl = words.find(std::string("owl"));
+        
+        ostringstream s1, s2;
+        descending.write(s1);
+        words.write(s2, ",");
+        
+        if (s1.str() == " 50  40  30  10 " && *descending.lower_bound(35) == 30 && descending.rank(10) == 3
+            && s2.str() == "bat,dolphin,Eel,lion,OWL,Panda,Tiger" && !duplicate && owl && owl->data == "OWL"
+            && CaseInsensitive::lessCalls == 0 && CaseInsensitive::compareCalls <= words.maxDepth()
+            && ThreeWayCompare<TreeLess>::compare(TreeLess(), -3, 7) < 0 && ThreeWayCompare<TreeLess>::compare(TreeLess(), 2.5, 2.5) == 0
+            && ThreeWayCompare<TreeLess>::compare(TreeLess(), std::string("b"), std::string("a")) > 0) {
+            cout << "14) Pass: trees ordered by std::greater and by a case-insensitive Compare, whose compare is used once per level\n";
+        } else {
+            cout << "14) Fail: trees ordered by std::greater and by a case-insensitive Compare give \"" << s1.str() << "\" and \"" << s2.str() << "\", find used compare " << CaseInsensitive::compareCalls << " times\n";
+            ++retval;
+        }
+    }
+    
+    {
+        BinarySearchTree<Revision> revisions;
+        for (int number : {7, 3, 9, 1, 5}) {
+            revisions.insert(Revision{number});
+        }
+        
+        bool allFound = true;
+        for (int number : {1, 3, 5, 7, 9}) {
+            TreeNode<Revision> * found = revisions.find(Revision{number});
+            allFound = allFound && found && found->data.number == number;
+        }
+        
+        if (allFound && !revisions.find(Revision{4}) && !revisions.insert(Revision{5})) {
+            cout << "15) Pass: a type with its own bool compare member is still searched with operator<\n";
+        } else {
+            cout << "15) Fail: a type with its own bool compare member should be searched with operator<\n";
+            ++retval;
+        }
+    }
+    
+    {
+        BinarySearchTree<int, std::allocator<int>, LessNamedCompare> predicates;
+        BinarySearchTree<long long, std::allocator<long long>, Difference> differences;
+        for (int number : {7, 3, 9, 1, 5}) {
+            predicates.insert(number);
+            differences.insert(number * (1LL << 32));
+        }
+        
+        bool allFound = true;
+        for (int number : {1, 3, 5, 7, 9}) {
+            allFound = allFound && predicates.find(number) && predicates.find(number)->data == number
+                       && differences.find(number * (1LL << 32)) && differences.find(number * (1LL << 32))->data == number * (1LL << 32);
+        }
+        
+        if (allFound && !predicates.find(4) && !differences.find(4 * (1LL << 32)) && !differences.find(0) && predicates.size() == 5) {
+            cout << "16) Pass: a Compare whose compare member returns bool is not used as three-way, and a long long compare result keeps its sign\n";
+        } else {
+            cout << "16) Fail: a Compare whose compare member returns bool should not be used as three-way, and a long long compare result should keep its sign\n";
+            ++retval;
+        }
+    }
     
     {
         
@@ -2,8 +2,13 @@
 #include "tree.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <iostream>
+#include <random>
+#include <set>
 #include <sstream> 
+#include <stdexcept>
 #include <vector>
 
 using std::cout;
@@ -11,6 +16,86 @@ using std::endl;
 using std::ostringstream;
 using std::vector;
 
+/**
+ * Check that the subtree rooted at the provided node is a valid AVL tree: ordered, with correct parent pointers,
+ * correct cached heights and sizes and every balance factor within [-1, 1].
+ * @param node Root of the subtree to check.
+ * @param count Incremented by the number of nodes in the subtree.
+ * @return measured height of the subtree, or -1 if the subtree is not a valid AVL tree.
+ */
+int validateAVL(const TreeNode<int> * node, size_t & count) {
+    if (!node) {
+        return 0;
+    }
+    size_t countBefore = count++;
+    if ((node->leftChild && (node->leftChild->parent != node || !(node->leftChild->data < node->data)))
+        || (node->rightChild && (node->rightChild->parent != node || !(node->data < node->rightChild->data)))) {
+        return -1;
+    }
+    int left = validateAVL(node->leftChild.get(), count);
+    int right = validateAVL(node->rightChild.get(), count);
+    if (left < 0 || right < 0 || left - right > 1 || right - left > 1) {
+        return -1;
+    }
+    int height = std::max(left, right) + 1;
+    return height == node->height && count - countBefore == node->size ? height : -1;
+}
+
+/**
+ * Check that the provided tree is a valid AVL tree containing the expected number of elements, and that its height
+ * is within the AVL bound of 1.44 * log2(n + 2).
+ * @param tree BinarySearchTree to check.
+ * @param expectedSize Number of elements that should be in the tree.
+ * @return true if the tree is valid.
+ */
+bool isValidAVL(const BinarySearchTree<int> & tree, size_t expectedSize) {
+    const TreeNode<int> * root = tree.begin().getNode();
+    while (root && root->parent) {
+        root = root->parent;
+    }
+    size_t count = 0;
+    int height = validateAVL(root, count);
+    return height >= 0 && count == expectedSize && height == tree.maxDepth()
+           && height <= 1.4405 * std::log2(expectedSize + 2.0);
+}
+
+/**
+ * An element that keeps count of its live instances and throws from its copy constructor once a copy limit is hit.
+ */
+class ThrowingCopy {
+
+public:
+
+    static std::atomic<int> alive;
+    static std::atomic<int> copiesLeft;
+
+    int value;
+
+    explicit ThrowingCopy(int valueIn)
+        : value(valueIn) {
+        ++alive;
+    }
+
+    ThrowingCopy(const ThrowingCopy & other)
+        : value(other.value) {
+        if (--copiesLeft < 0) {
+            throw std::runtime_error("copy limit reached");
+        }
+        ++alive;
+    }
+
+    ~ThrowingCopy() {
+        --alive;
+    }
+
+    bool operator<(const ThrowingCopy & other) const {
+        return value < other.value;
+    }
+};
+
+std::atomic<int> ThrowingCopy::alive(0);
+std::atomic<int> ThrowingCopy::copiesLeft(0);
+
 int main() {
     
     int retval = 0;
@@ -140,6 +225,435 @@ int main() {
         }
     }
     
+    {
+        BinarySearchTree<int> tree;
+        const int n = 1000000;
+        
+        for (int i = 0; i < n; ++i) {
+            tree.insert(i);
+        }
+        
+        if (isValidAVL(tree, n)) {
+            cout << "8) Pass: After inserting 0.." << n - 1 << " in order, the tree is a valid AVL tree of depth " << tree.maxDepth() << "\n";
+        } else {
+            ++retval;
+            cout << "8) Fail: After inserting 0.." << n - 1 << " in order, the tree is not a valid AVL tree (max depth " << tree.maxDepth() << ")\n";
+        }
+    }
+    
+    {
+        BinarySearchTree<int> tree;
+        std::mt19937 generator(42);
+        vector<int> putIn(1000000);
+        
+        for (int & e : putIn) {
+            e = static_cast<int>(generator());
+            tree.insert(e);
+        }
+        
+        std::sort(putIn.begin(), putIn.end());
+        size_t distinct = std::unique(putIn.begin(), putIn.end()) - putIn.begin();
+        
+        if (isValidAVL(tree, distinct)) {
+            cout << "9) Pass: After inserting " << putIn.size() << " random numbers, the tree is a valid AVL tree of depth " << tree.maxDepth() << "\n";
+        } else {
+            ++retval;
+            cout << "9) Fail: After inserting " << putIn.size() << " random numbers, the tree is not a valid AVL tree (max depth " << tree.maxDepth() << ")\n";
+        }
+    }
+    
+    {
+        BinarySearchTree<int> tree;
+        vector<int> putIn(200000);
+        
+        for (size_t i = 0; i < putIn.size(); ++i) {
+            putIn[i] = static_cast<int>(i);
+            tree.insert(putIn[i]);
+        }
+        
+        std::shuffle(putIn.begin(), putIn.end(), std::mt19937(7));
+        
+        size_t remaining = putIn.size();
+        bool valid = true;
+        for (size_t i = 0; i < putIn.size() / 2; ++i) {
+            valid = valid && tree.erase(putIn[i]);
+            --remaining;
+            if (i % 10000 == 0) {
+                valid = valid && isValidAVL(tree, remaining);
+            }
+        }
+        valid = valid && isValidAVL(tree, remaining) && !tree.find(putIn[0]) && tree.find(putIn.back());
+        
+        if (valid) {
+            cout << "10) Pass: After erasing half of 0.." << putIn.size() - 1 << " in random order, the tree is a valid AVL tree of depth " << tree.maxDepth() << "\n";
+        } else {
+            ++retval;
+            cout << "10) Fail: After erasing half of 0.." << putIn.size() - 1 << " in random order, the tree is not a valid AVL tree (max depth " << tree.maxDepth() << ")\n";
+        }
+        
+        for (size_t i = putIn.size() / 2; i < putIn.size(); ++i) {
+            tree.erase(putIn[i]);
+        }
+        
+        if (tree.begin() == tree.end() && tree.maxDepth() == 0) {
+            cout << "11) Pass: After erasing every element, the tree is empty\n";
+        } else {
+            ++retval;
+            cout << "11) Fail: After erasing every element, the tree should be empty\n";
+        }
+    }
+    
+    {
+        vector<int> putIn(1000000);
+        for (size_t i = 0; i < putIn.size(); ++i) {
+            putIn[i] = static_cast<int>(i);
+        }
+        
+        BinarySearchTree<int> tree = BinarySearchTree<int>::fromSorted(putIn.begin(), putIn.end());
+        
+        if (isValidAVL(tree, putIn.size()) && tree.maxDepth() == 20 && tree.find(0) && tree.find(999999)) {
+            cout << "12) Pass: Building a tree from 0..999999 in order yields a valid AVL tree of depth 20\n";
+        } else {
+            ++retval;
+            cout << "12) Fail: Building a tree from 0..999999 in order should yield a valid AVL tree of depth 20, but has depth " << tree.maxDepth() << "\n";
+        }
+    }
+    
+    {
+        vector<int> putIn{5, 3, 9, 3, 1, 9};
+        
+        BinarySearchTree<int> tree = BinarySearchTree<int>::fromUnsorted(putIn.begin(), putIn.end());
+        
+        ostringstream s;
+        tree.write(s);
+        
+        if (s.str() == " 1  3  5  9 " && isValidAVL(tree, 4)) {
+            cout << "13) Pass: Building a tree from the unsorted 5,3,9,3,1,9 yields \" 1  3  5  9 \"\n";
+        } else {
+            ++retval;
+            cout << "13) Fail: Building a tree from the unsorted 5,3,9,3,1,9 should yield \" 1  3  5  9 \" but it gives \"" << s.str() << "\"\n";
+        }
+    }
+    
+    {
+        BinarySearchTree<int> tree;
+        std::mt19937 generator(3);
+        vector<int> putIn(100000);
+        
+        for (int & e : putIn) {
+            e = static_cast<int>(generator());
+            tree.insert(e);
+        }
+        
+        BinarySearchTree<int> copy(tree);
+        std::sort(putIn.begin(), putIn.end());
+        size_t distinct = std::unique(putIn.begin(), putIn.end()) - putIn.begin();
+        
+        bool sameShape = true;
+        for (size_t i = 0; i < distinct && sameShape; ++i) {
+            TreeNode<int> * original = tree.find(putIn[i]);
+            TreeNode<int> * copied = copy.find(putIn[i]);
+            sameShape = copied && copied != original && copied->height == original->height
+                        && (copied->parent ? copied->parent->data : 0) == (original->parent ? original->parent->data : 0);
+        }
+        
+        if (sameShape && isValidAVL(copy, distinct)) {
+            cout << "14) Pass: A copy of a tree with " << distinct << " random numbers has the same shape and heights\n";
+        } else {
+            ++retval;
+            cout << "14) Fail: A copy of a tree with " << distinct << " random numbers should have the same shape and heights\n";
+        }
+    }
+    
+    {
+        BinarySearchTree<int> tree;
+        std::mt19937 generator(11);
+        vector<int> putIn;
+        
+        for (int i = 0; i < 100000; ++i) {
+            int e = static_cast<int>(generator() % 1000000) * 2;
+            tree.insert(e);
+            putIn.push_back(e);
+        }
+        for (int i = 0; i < 100000; i += 3) {
+            tree.erase(putIn[i]);
+        }
+        
+        vector<int> remaining;
+        for (int i = 0; i < 100000; ++i) {
+            if (tree.find(putIn[i])) {
+                remaining.push_back(putIn[i]);
+            }
+        }
+        std::sort(remaining.begin(), remaining.end());
+        remaining.erase(std::unique(remaining.begin(), remaining.end()), remaining.end());
+        
+        bool correct = tree.size() == remaining.size() && !tree.select(remaining.size()) && isValidAVL(tree, remaining.size());
+        for (size_t i = 0; i < remaining.size() && correct; ++i) {
+            TreeNode<int> * selected = tree.select(i);
+            correct = selected && selected->data == remaining[i] && tree.rank(remaining[i]) == i
+                      && tree.rank(remaining[i] + 1) == i + 1;
+        }
+        
+        if (correct) {
+            cout << "15) Pass: After random inserts and erases, size, rank and select agree with the sorted elements\n";
+        } else {
+            ++retval;
+            cout << "15) Fail: After random inserts and erases, size, rank and select should agree with the sorted elements\n";
+        }
+    }
+    
+    {
+        BinarySearchTree<int> tree;
+        vector<int> putIn(100000);
+        std::mt19937 generator(99);
+        for (int & e : putIn) {
+            e = static_cast<int>(generator() % 1000000);
+            tree.insert(e);
+        }
+        std::sort(putIn.begin(), putIn.end());
+        putIn.erase(std::unique(putIn.begin(), putIn.end()), putIn.end());
+        
+        const BinarySearchTree<int> & constTree = tree;
+        vector<int> forwards(constTree.begin(), constTree.end());
+        vector<int> backwards(tree.rbegin(), tree.rend());
+        std::reverse(backwards.begin(), backwards.end());
+        
+        auto middle = std::lower_bound(tree.begin(), tree.end(), putIn[putIn.size() / 2]);
+        BinarySearchTree<int>::const_iterator last = --tree.end();
+        
+        if (forwards == putIn && backwards == putIn && *last == putIn.back()
+            && static_cast<size_t>(std::distance(tree.begin(), tree.end())) == putIn.size()
+            && *middle == putIn[putIn.size() / 2] && *std::prev(middle) == putIn[putIn.size() / 2 - 1]
+            && std::is_sorted(tree.cbegin(), tree.cend())) {
+            cout << "16) Pass: After random inserts, the tree iterates its elements sorted forwards and backwards\n";
+        } else {
+            ++retval;
+            cout << "16) Fail: After random inserts, the tree should iterate its elements sorted forwards and backwards\n";
+        }
+    }
+    
+    {
+        BinarySearchTree<int> tree;
+        vector<int> putIn(100000);
+        std::mt19937 generator(5);
+        for (int & e : putIn) {
+            e = static_cast<int>(generator() % 1000000);
+            tree.insert(e);
+        }
+        std::sort(putIn.begin(), putIn.end());
+        putIn.erase(std::unique(putIn.begin(), putIn.end()), putIn.end());
+        
+        vector<int> all, some;
+        tree.forEach([&](int e) { all.push_back(e); });
+        tree.scan(250000, 750000, [&](int e) { some.push_back(e); });
+        
+        vector<int> expected(std::lower_bound(putIn.begin(), putIn.end(), 250000),
+                             std::lower_bound(putIn.begin(), putIn.end(), 750000));
+        
+        if (all == putIn && some == expected) {
+            cout << "17) Pass: After random inserts, forEach visits every element and scan every element in [250000, 750000) in order\n";
+        } else {
+            ++retval;
+            cout << "17) Fail: After random inserts, forEach should visit every element and scan every element in [250000, 750000) in order\n";
+        }
+    }
+    
+    {
+        BinarySearchTree<int> tree;
+        std::set<int> reference;
+        std::mt19937 generator(17);
+        bool correct = true;
+        
+        for (size_t batchSize : {100000u, 10u, 1000u, 50000u, 3u, 200000u}) {
+            vector<int> batch(batchSize);
+            for (int & e : batch) {
+                e = static_cast<int>(generator() % 500000);
+            }
+            size_t before = reference.size();
+            reference.insert(batch.begin(), batch.end());
+            size_t inserted = tree.insertBatch(batch.begin(), batch.end());
+            correct = correct && inserted == reference.size() - before && isValidAVL(tree, reference.size());
+        }
+        
+        vector<int> was(tree.begin(), tree.end());
+        
+        if (correct && was == vector<int>(reference.begin(), reference.end())) {
+            cout << "18) Pass: After inserting random batches of 3 to 200000 elements, the tree is a valid AVL tree holding all of them\n";
+        } else {
+            ++retval;
+            cout << "18) Fail: After inserting random batches of 3 to 200000 elements, the tree should be a valid AVL tree holding all of them\n";
+        }
+    }
+    
+    {
+        BinarySearchTree<int> tree;
+        std::set<int> reference;
+        std::mt19937 generator(19);
+        for (int i = 0; i < 100000; ++i) {
+            int e = static_cast<int>(generator() % 1000000);
+            tree.insert(e);
+            reference.insert(e);
+        }
+        bool correct = true;
+        
+        for (int key : {-5, 0, 250000, 999999, 1000001, 500000, 123456}) {
+            BinarySearchTree<int> greater = tree.split(key);
+            size_t smallerCount = std::distance(reference.begin(), reference.lower_bound(key));
+            correct = correct && isValidAVL(tree, smallerCount) && isValidAVL(greater, reference.size() - smallerCount)
+                      && (tree.size() == 0 || *tree.rbegin() < key) && (greater.size() == 0 || !(*greater.begin() < key));
+            
+            if (greater.size() > 0) {
+                BinarySearchTree<int> overlapping;
+                overlapping.insert(*greater.begin());
+                correct = correct && !greater.join(std::move(overlapping)) && overlapping.size() == 1;
+            }
+            
+            if (key % 2) {
+                correct = correct && greater.join(std::move(tree)) && tree.size() == 0;
+                tree = std::move(greater);
+            } else {
+                correct = correct && tree.join(std::move(greater)) && greater.size() == 0;
+            }
+            correct = correct && isValidAVL(tree, reference.size());
+        }
+        
+        BinarySearchTree<int> small;
+        small.insert(-1);
+        BinarySearchTree<int> big;
+        for (int i = 2000000; i < 2001000; ++i) {
+            big.insert(i);
+        }
+        correct = correct && tree.join(std::move(small)) && tree.join(std::move(big))
+                  && isValidAVL(tree, reference.size() + 1001);
+        reference.insert(-1);
+        for (int i = 2000000; i < 2001000; ++i) {
+            reference.insert(i);
+        }
+
+        // Both halves end up joined onto a spine whose heights drop by two right before the empty side
+        BinarySearchTree<int> leftLeaning;
+        BinarySearchTree<int> rightLeaning;
+        for (int e : {3, 2, 4, 1}) {
+            leftLeaning.insert(e);
+            rightLeaning.insert(5 - e);
+        }
+        BinarySearchTree<int> leftLeaningGreater = leftLeaning.split(4);
+        BinarySearchTree<int> rightLeaningGreater = rightLeaning.split(2);
+        correct = correct && isValidAVL(leftLeaning, 3) && isValidAVL(leftLeaningGreater, 1)
+                  && isValidAVL(rightLeaning, 1) && isValidAVL(rightLeaningGreater, 3);
+
+        vector<int> was(tree.begin(), tree.end());
+        
+        if (correct && was == vector<int>(reference.begin(), reference.end())) {
+            cout << "19) Pass: Splitting a tree at a key and joining the halves back gives valid AVL trees holding the right elements\n";
+        } else {
+            ++retval;
+            cout << "19) Fail: Splitting a tree at a key and joining the halves back should give valid AVL trees holding the right elements\n";
+        }
+    }
+    
+    {
+        std::mt19937 generator(23);
+        std::set<int> first;
+        std::set<int> second;
+        for (int i = 0; i < 200000; ++i) {
+            first.insert(static_cast<int>(generator() % 400000));
+            second.insert(static_cast<int>(generator() % 400000));
+        }
+        vector<int> united;
+        vector<int> common;
+        vector<int> onlyFirst;
+        std::set_union(first.begin(), first.end(), second.begin(), second.end(), std::back_inserter(united));
+        std::set_intersection(first.begin(), first.end(), second.begin(), second.end(), std::back_inserter(common));
+        std::set_difference(first.begin(), first.end(), second.begin(), second.end(), std::back_inserter(onlyFirst));
+        vector<int> firstSorted(first.begin(), first.end());
+        vector<int> secondSorted(second.begin(), second.end());
+        bool correct = true;
+        
+        for (unsigned threads : {1u, 4u}) {
+            BinarySearchTree<int> b = BinarySearchTree<int>::fromSorted(secondSorted.begin(), secondSorted.end(), threads);
+            
+            BinarySearchTree<int> unionTree = BinarySearchTree<int>::fromSorted(firstSorted.begin(), firstSorted.end(), threads);
+            correct = correct && isValidAVL(unionTree, first.size());
+            unionTree.unionWith(b, threads);
+            BinarySearchTree<int> intersectionTree = BinarySearchTree<int>::fromSorted(firstSorted.begin(), firstSorted.end());
+            intersectionTree.intersect(b, threads);
+            BinarySearchTree<int> differenceTree = BinarySearchTree<int>::fromSorted(firstSorted.begin(), firstSorted.end());
+            differenceTree.difference(std::move(b), threads);
+            
+            correct = correct && b.size() == 0
+                      && isValidAVL(unionTree, united.size()) && vector<int>(unionTree.begin(), unionTree.end()) == united
+                      && isValidAVL(intersectionTree, common.size()) && vector<int>(intersectionTree.begin(), intersectionTree.end()) == common
+                      && isValidAVL(differenceTree, onlyFirst.size()) && vector<int>(differenceTree.begin(), differenceTree.end()) == onlyFirst;
+        }
+        
+        if (correct) {
+            cout << "20) Pass: The union, intersection and difference of two random trees, on 1 and 4 threads, are valid AVL trees holding the right elements\n";
+        } else {
+            ++retval;
+            cout << "20) Fail: The union, intersection and difference of two random trees, on 1 and 4 threads, should be valid AVL trees holding the right elements\n";
+        }
+    }
+
+    {
+        BinarySearchTree<int> tree;
+        std::set<int> reference;
+        for (int i = 0; i < 200000; ++i) {
+            tree.insert(2 * i);
+            reference.insert(2 * i);
+        }
+        bool correct = true;
+
+        // Every batch falls into a narrow key range and starts and ends with elements already in the tree
+        for (int start : {0, 1000, 150000, 399000}) {
+            vector<int> batch;
+            for (int e = start; e <= start + 1000; ++e) {
+                batch.push_back(e);
+            }
+            size_t before = reference.size();
+            reference.insert(batch.begin(), batch.end());
+            size_t inserted = tree.insertBatch(batch.begin(), batch.end());
+            correct = correct && inserted == reference.size() - before && isValidAVL(tree, reference.size());
+        }
+
+        vector<int> was(tree.begin(), tree.end());
+
+        if (correct && was == vector<int>(reference.begin(), reference.end())) {
+            cout << "21) Pass: After inserting batches that fall into narrow key ranges, the tree is a valid AVL tree holding all of them\n";
+        } else {
+            ++retval;
+            cout << "21) Fail: After inserting batches that fall into narrow key ranges, the tree should be a valid AVL tree holding all of them\n";
+        }
+    }
+
+    {
+        vector<ThrowingCopy> sorted;
+        sorted.reserve(100000);
+        for (int i = 0; i < 100000; ++i) {
+            sorted.emplace_back(i);
+        }
+        bool correct = true;
+
+        for (unsigned threads : {1u, 4u}) {
+            ThrowingCopy::copiesLeft = 70000;
+            bool thrown = false;
+            try {
+                BinarySearchTree<ThrowingCopy>::fromSorted(sorted.begin(), sorted.end(), threads);
+            } catch (const std::runtime_error &) {
+                thrown = true;
+            }
+            correct = correct && thrown && ThrowingCopy::alive == static_cast<int>(sorted.size());
+        }
+
+        if (correct) {
+            cout << "22) Pass: When copying an element throws halfway through fromSorted, on 1 and 4 threads, every TreeNode built so far is freed\n";
+        } else {
+            ++retval;
+            cout << "22) Fail: When copying an element throws halfway through fromSorted, on 1 and 4 threads, every TreeNode built so far should be freed\n";
+        }
+    }
+
     return retval;
     
 }
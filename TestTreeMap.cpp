@@ -1,14 +1,68 @@
 #include "treemap.h"
 
+#include <functional>
 #include <iostream>
 #include <sstream> 
 #include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 using std::cout;
 using std::endl;
+using std::ostream;
 using std::ostringstream;
 using std::string;
 
+/**
+ * A Value that counts how many times it got constructed and copied.
+ */
+class CountedValue {
+    
+public:
+    
+    static int constructed;
+    static int copied;
+    
+    string payload;
+    
+    CountedValue() = default;
+    
+    explicit CountedValue(const string & payloadIn)
+        : payload(payloadIn) {
+        ++constructed;
+    }
+    
+    CountedValue(const CountedValue & other)
+        : payload(other.payload) {
+        ++constructed;
+        ++copied;
+    }
+    
+    CountedValue(CountedValue && other)
+        : payload(std::move(other.payload)) {
+        ++constructed;
+    }
+    
+    CountedValue & operator=(const CountedValue & other) {
+        payload = other.payload;
+        ++copied;
+        return *this;
+    }
+    
+    CountedValue & operator=(CountedValue && other) {
+        payload = std::move(other.payload);
+        return *this;
+    }
+};
+
+int CountedValue::constructed = 0;
+int CountedValue::copied = 0;
+
+ostream & operator<<(ostream & o, const CountedValue & value) {
+    return o << value.payload;
+}
+
 int main() {
     
     int retval = 0;
@@ -67,12 +121,303 @@ int main() {
             }
         }
         
+        {
+            bool erased = tree.erase(2);
+            ostringstream s;
+            tree.write(s);
+            
+            if (erased && s.str() == " 1,lion  5,panda  6,llama ") {
+                cout << "\n5) Pass: erasing 2 removes dolphin from the tree";
+            } else {
+                cout << "\n5) Fail: erasing 2 should yield the tree \" 1,lion  5,panda  6,llama \" but it gives \"" << s.str() << "\"\n";
+                ++retval;
+            }
+        }
+        
 
         cout << endl;
         
         
     }         
     
+    {
+        std::vector<std::pair<int, string> > pairs{{6, "llama"}, {1, "lion"}, {5, "panda"}, {1, "tiger"}};
+        
+        TreeMap<int, string> tree = TreeMap<int, string>::fromUnsorted(pairs.begin(), pairs.end());
+        
+        ostringstream s;
+        tree.write(s);
+        
+        if (s.str() == " 1,lion  5,panda  6,llama ") {
+            cout << "6) Pass: building a TreeMap from unsorted pairs with a duplicate key keeps the first pair for each key\n";
+        } else {
+            cout << "6) Fail: building a TreeMap from unsorted pairs should yield \" 1,lion  5,panda  6,llama \" but it gives \"" << s.str() << "\"\n";
+            ++retval;
+        }
+    }
+    
+    {
+        TreeMap<int, CountedValue> tree;
+        
+        auto first = tree.try_emplace(1, "lion");
+        auto second = tree.try_emplace(1, "tiger");
+        
+        if (first.second && !second.second && second.first == first.first && first.first->v.payload == "lion"
+            && CountedValue::constructed == 1 && CountedValue::copied == 0) {
+            cout << "7) Pass: try_emplace constructs the value once, in place, and not at all for an existing key\n";
+        } else {
+            cout << "7) Fail: try_emplace should construct the value once, in place, but it was constructed " << CountedValue::constructed << " times and copied " << CountedValue::copied << " times\n";
+            ++retval;
+        }
+        
+        auto assigned = tree.insert_or_assign(1, CountedValue("tiger"));
+        auto inserted = tree.insert_or_assign(2, CountedValue("dolphin"));
+        
+        if (!assigned.second && assigned.first->v.payload == "tiger" && inserted.second && inserted.first->v.payload == "dolphin"
+            && CountedValue::copied == 0 && !tree.insert(2, CountedValue("llama"))) {
+            cout << "8) Pass: insert_or_assign moves the value over an existing key or into a new one, insert refuses an existing key\n";
+        } else {
+            cout << "8) Fail: insert_or_assign should move the value over an existing key or into a new one, and insert should refuse an existing key\n";
+            ++retval;
+        }
+        
+        TreeMap<int, CountedValue> moved(std::move(tree));
+        TreeMap<int, CountedValue> assignedMap;
+        assignedMap = std::move(moved);
+        
+        ostringstream s1, s2;
+        moved.write(s1);
+        tree.write(s2);
+        
+        if (s1.str().empty() && s2.str().empty() && assignedMap.find(2) && assignedMap.find(2)->v.payload == "dolphin"
+            && std::is_nothrow_move_constructible<TreeMap<int, CountedValue> >::value
+            && std::is_nothrow_move_assignable<TreeMap<int, CountedValue> >::value) {
+            cout << "9) Pass: TreeMaps are moved without exceptions, leaving the moved-from maps empty\n";
+        } else {
+            cout << "9) Fail: TreeMaps should be moved without exceptions, leaving the moved-from maps empty\n";
+            ++retval;
+        }
+    }
+    
+    {
+        TreeMap<int, string> tree;
+        for (int i = 1; i <= 100; ++i) {
+            tree.insert(i * 10, std::to_string(i));
+        }
+        
+        KeyValuePair<int, string> * median = tree.select(tree.size() / 2);
+        const TreeMap<int, string> & constTree = tree;
+        bool readOnly = std::is_same<decltype(constTree.select(0)), const KeyValuePair<int, string> *>::value;
+        
+        if (tree.size() == 100 && median && median->k == 510 && tree.rank(955) == 95 && tree.rank(10) == 0 && !tree.select(100)
+            && readOnly && constTree.select(50) == median) {
+            cout << "10) Pass: a TreeMap of 10, 20, .., 1000 has 100 keys, 510 at position 50 and 95 keys below 955, and a const one selects read-only pairs\n";
+        } else {
+            cout << "10) Fail: a TreeMap of 10, 20, .., 1000 should have 100 keys, 510 at position 50 and 95 keys below 955, and a const one should select read-only pairs\n";
+            ++retval;
+        }
+    }
+    
+    {
+        TreeMap<int, string> tree;
+        tree.insert(5, "panda");
+        tree.insert(1, "lion");
+        tree.insert(2, "dolphin");
+        tree.insert(8, "owl");
+        
+        auto equal = tree.equal_range(2);
+        auto animals = tree.range(2, 8);
+        
+        if (tree.begin().getNode()->data.k == 1 && tree.lower_bound(3).getNode()->data.v == "panda"
+            && tree.upper_bound(8) == tree.end() && equal.first.getNode()->data.v == "dolphin"
+            && equal.second.getNode()->data.k == 5 && animals.size() == 2 && (*animals.begin()).v == "dolphin"
+            && animals.end().getNode()->data.v == "owl") {
+            cout << "11) Pass: the TreeMap finds the bounds of its keys and the range [2, 8) holds dolphin and panda\n";
+        } else {
+            cout << "11) Fail: the TreeMap should find the bounds of its keys and the range [2, 8) should hold dolphin and panda\n";
+            ++retval;
+        }
+    }
+    
+    {
+        TreeMap<int, string> tree;
+        tree.insert(5, "panda");
+        tree.insert(1, "lion");
+        tree.insert(2, "dolphin");
+        tree.insert(8, "owl");
+        
+        tree.forEach([](KeyValuePair<int, string> & pair) { pair.v += "s"; });
+        
+        ostringstream s;
+        tree.scan(2, 8, [&](const KeyValuePair<int, string> & pair) { s << pair; });
+        
+        if (s.str() == "2,dolphins5,pandas") {
+            cout << "12) Pass: forEach changes every Value and scan over [2, 8) yields \"2,dolphins5,pandas\"\n";
+        } else {
+            cout << "12) Fail: forEach should change every Value and scan over [2, 8) should yield \"2,dolphins5,pandas\" but it gives \"" << s.str() << "\"\n";
+            ++retval;
+        }
+    }
+    
+    {
+        TreeMap<int, string> tree;
+        tree.insert(5, "panda");
+        tree.insert(1, "lion");
+        
+        std::vector<std::pair<int, string> > batch;
+        batch.push_back(std::make_pair(8, "owl"));
+        batch.push_back(std::make_pair(2, "dolphin"));
+        batch.push_back(std::make_pair(5, "koala"));
+        batch.push_back(std::make_pair(8, "bat"));
+        size_t inserted = tree.insertBatch(batch.begin(), batch.end());
+        
+        ostringstream s;
+        tree.write(s);
+        
+        if (inserted == 2 && s.str() == " 1,lion  2,dolphin  5,panda  8,owl ") {
+            cout << "13) Pass: inserting a batch adds the new Keys only, yielding \" 1,lion  2,dolphin  5,panda  8,owl \"\n";
+        } else {
+            cout << "13) Fail: inserting a batch should add the new Keys only, yielding \" 1,lion  2,dolphin  5,panda  8,owl \" but it gives \"" << s.str() << "\"\n";
+            ++retval;
+        }
+    }
+    
+    {
+        TreeMap<int, string> tree;
+        tree.insert(5, "panda");
+        tree.insert(1, "lion");
+        tree.insert(8, "owl");
+        tree.insert(2, "dolphin");
+        
+        TreeMap<int, string> greater = tree.split(3);
+        ostringstream smaller;
+        tree.write(smaller);
+        ostringstream notSmaller;
+        greater.write(notSmaller);
+        bool joined = greater.join(std::move(tree));
+        ostringstream s;
+        greater.write(s);
+        
+        if (smaller.str() == " 1,lion  2,dolphin " && notSmaller.str() == " 5,panda  8,owl " && joined
+            && s.str() == " 1,lion  2,dolphin  5,panda  8,owl ") {
+            cout << "14) Pass: splitting at 3 gives \" 1,lion  2,dolphin \" and \" 5,panda  8,owl \", joining them gives everything back\n";
+        } else {
+            cout << "14) Fail: splitting at 3 should give \" 1,lion  2,dolphin \" and \" 5,panda  8,owl \" but it gives \"" << smaller.str() << "\" and \"" << notSmaller.str() << "\"\n";
+            ++retval;
+        }
+    }
+    
+    {
+        TreeMap<int, string> tree;
+        tree.insert(5, "panda");
+        tree.insert(1, "lion");
+        tree.insert(8, "owl");
+        TreeMap<int, string> other;
+        other.insert(5, "koala");
+        other.insert(2, "dolphin");
+        other.insert(9, "bat");
+        TreeMap<int, string> common;
+        common.insert(5, "koala");
+        common.insert(9, "bat");
+        TreeMap<int, string> removed;
+        removed.insert(1, "tiger");
+        
+        tree.unionWith(std::move(other));
+        ostringstream united;
+        tree.write(united);
+        tree.intersect(std::move(common));
+        tree.difference(std::move(removed));
+        ostringstream s;
+        tree.write(s);
+        
+        if (united.str() == " 1,lion  2,dolphin  5,panda  8,owl  9,bat " && s.str() == " 5,panda  9,bat ") {
+            cout << "15) Pass: union, intersection and difference by Key keep this TreeMap's Values, yielding \" 5,panda  9,bat \"\n";
+        } else {
+            cout << "15) Fail: union, intersection and difference by Key should keep this TreeMap's Values, yielding \" 5,panda  9,bat \" but it gives \"" << s.str() << "\"\n";
+            ++retval;
+        }
+    }
+    
+    {
+        TreeMap<int, string> tree;
+        tree.insert(5, "panda");
+        tree.insert(1, "lion");
+        tree.insert(8, "owl");
+        tree.insert(2, "dolphin");
+        
+        ostringstream plain, json;
+        tree.write(plain, ";");
+        json << "{";
+        tree.writeRange(json, 2, 8, ", ", [](BufferedSink & sink, const KeyValuePair<int, string> & pair) {
+            sink.append('"');
+            sink.appendValue(pair.k);
+            sink.append("\": \"");
+            sink.append(pair.v);
+            sink.append('"');
+        });
+        json << "}";
+        
+        if (plain.str() == "1,lion;2,dolphin;5,panda;8,owl" && json.str() == "{\"2\": \"dolphin\", \"5\": \"panda\"}") {
+            cout << "16) Pass: the TreeMap is written as \"1,lion;2,dolphin;5,panda;8,owl\" and [2, 8) as " << json.str() << "\n";
+        } else {
+            cout << "16) Fail: the TreeMap should be written as \"1,lion;2,dolphin;5,panda;8,owl\" but gives \"" << plain.str() << "\" and " << json.str() << "\n";
+            ++retval;
+        }
+    }
+    
+    {
+        TreeMap<string, CountedValue> tree;
+        tree.try_emplace("panda", "bamboo");
+        tree.try_emplace("lion", "zebra");
+        tree.try_emplace("owl", "mouse");
+        const TreeMap<string, CountedValue> & constTree = tree;
+        CountedValue::constructed = 0;
+        CountedValue::copied = 0;
+        
+        KeyValuePair<string, CountedValue> * lion = tree.find("lion");
+        const KeyValuePair<string, CountedValue> * owl = constTree.find("owl");
+        bool missing = tree.find("tiger") == nullptr && constTree.find("ant") == nullptr;
+        bool erased = tree.erase("panda") && !tree.erase("panda");
+        
+        if (lion && lion->v.payload == "zebra" && owl && owl->v.payload == "mouse" && missing && erased
+            && CountedValue::constructed == 0 && CountedValue::copied == 0) {
+            cout << "17) Pass: find and erase by Key return nullptr or false for missing Keys and never build or copy a Value\n";
+        } else {
+            cout << "17) Fail: find and erase by Key should return nullptr or false for missing Keys without building a Value, but a Value was constructed " << CountedValue::constructed << " times\n";
+            ++retval;
+        }
+    }
+    
+    {
+        typedef TreeMap<int, string, std::allocator<KeyValuePair<int, string> >, std::greater<int> > DescendingMap;
+        std::vector<std::pair<int, string> > animals = {{5, "panda"}, {1, "lion"}, {8, "owl"}, {2, "dolphin"}, {5, "bat"}};
+        DescendingMap tree = DescendingMap::fromUnsorted(animals.begin(), animals.end());
+        tree.insert(9, "tiger");
+        bool erased = tree.erase(2);
+        auto frozen = tree.freeze();
+        
+        TreeMap<int, int, std::allocator<KeyValuePair<int, int> >, std::greater<int> > numbers, loaded;
+        for (int i = 0; i < 100; ++i) {
+            numbers.insert(i, i * i);
+        }
+        std::stringstream snapshot;
+        numbers.writeBinary(snapshot);
+        bool read = loaded.readBinary(snapshot);
+        
+        ostringstream s;
+        tree.write(s, " ");
+        
+        if (s.str() == "9,tiger 8,owl 5,panda 1,lion" && erased && tree.find(8) && tree.find(8)->v == "owl" && !tree.find(2)
+            && tree.lower_bound(6)->k == 5 && frozen.find(9) && frozen.lower_bound(7)->k == 5 && !frozen.find(2)
+            && read && loaded.size() == 100 && loaded.begin()->k == 99 && loaded.find(7)->v == 49
+            && tree.key_comp()(2, 1)) {
+            cout << "18) Pass: a TreeMap ordered by std::greater is written as \"9,tiger 8,owl 5,panda 1,lion\" and searched, frozen and reloaded in that order\n";
+        } else {
+            cout << "18) Fail: a TreeMap ordered by std::greater should be written as \"9,tiger 8,owl 5,panda 1,lion\" but gives \"" << s.str() << "\"\n";
+            ++retval;
+        }
+    }
+    
     return retval;
     
 }
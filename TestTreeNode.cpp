@@ -2,10 +2,12 @@
 
 #include <iostream>
 #include <sstream> 
+#include <string>
 
 using std::cout;
 using std::endl;
 using std::ostringstream;
+using std::string;
 
 int main() {
     
@@ -76,8 +78,52 @@ int main() {
          
         }
         
+        root->leftChild->updateHeight();
+        root->updateHeight();
+        
+        if (root->height == 3 && root->balanceFactor() == 1) {
+            cout << "8) Pass: after updating the cached heights the root has height 3 and balance factor 1\n";
+        } else {
+            cout << "8) Fail: after updating the cached heights the root should have height 3 and balance factor 1, but has height " << root->height << " and balance factor " << root->balanceFactor() << "\n";
+            ++retval;
+        }
+        
+    }
+    
+    {
+        // A chain of left children, the worst shape for a recursive walk
+        const int length = 1000000;
+        unique_ptr<TreeNode<int>> root(new TreeNode<int>(length));
+        TreeNode<int> * node = root.get();
+        for (int i = length - 1; i > 0; --i) {
+            node->setLeftChild(new TreeNode<int>(i));
+            node = node->leftChild.get();
+        }
+        node->setRightChild(new TreeNode<int>(0));
+        
+        ostringstream s;
+        root->write(s);
+        string written = s.str();
+        
+        // Free the chain from the bottom up, so that the unique_ptrs do not recurse either
+        while (node) {
+            TreeNode<int> * nodesParent = node->parent;
+            if (nodesParent) {
+                nodesParent->leftChild.reset();
+            }
+            node = nodesParent;
+        }
+        
+        if (written.compare(0, 9, " 1  0  2 ") == 0 && written.size() > 7 * length
+            && written.compare(written.size() - 9, 9, " 1000000 ") == 0) {
+            cout << "9) Pass: a chain of a million nodes prints without recursion, starting \" 1  0  2 \" and ending \" 1000000 \"\n";
+        } else {
+            cout << "9) Fail: a chain of a million nodes should print starting \" 1  0  2 \" and ending \" 1000000 \"\n";
+            ++retval;
+        }
+        
         cout << "\n";
-    }         
+    }
     
     return retval;
     
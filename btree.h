@@ -0,0 +1,566 @@
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+#if defined(__GNUC__) && (defined(__SSE2__) || defined(__AVX2__))
+#define BTREE_HAS_SIMD 1
+#include <immintrin.h>
+#else
+#define BTREE_HAS_SIMD 0
+#endif
+
+using std::ostream;
+
+/**
+ * BTreeKeySearch finds where a key belongs in the sorted keys of a BTreeNode. This is the scalar version, used for any
+ * data type: a linear scan using only operator<, which is as fast as a binary search for a handful of keys.
+ * @tparam T Data type stored in the BTree.
+ *
+ * @author Vakaris Paulavičius (K20062023)
+ * @version 1.0
+ */
+template<typename T, typename Enable = void>
+struct BTreeKeySearch {
+
+    // Whether the unused keys of a BTreeNode must hold the greatest value of T, so that whole arrays can be compared
+    static const bool padded = false;
+
+    /**
+     * Count the keys that are not greater than the provided one.
+     * @param keys Sorted keys of a BTreeNode.
+     * @param count Number of keys in use.
+     * @param key Key to look for.
+     * @return number of keys not greater than the key, which is the index of the child to descend to.
+     */
+    static unsigned countNotGreater(const T * keys, unsigned count, const T & key) {
+        unsigned i = 0;
+        while(i < count && !(key < keys[i])) {
+            ++i;
+        }
+        return i;
+    }
+
+};
+
+#if BTREE_HAS_SIMD
+
+/**
+ * BTreeKeySearch for 32-bit integers: compares the key with all 16 keys of a BTreeNode at once, with two AVX2 or four
+ * SSE2 compares, and counts the greater ones from the compare mask. The compares are signed, so unsigned keys have
+ * their top bit flipped first.
+ */
+template<typename T>
+struct BTreeKeySearch<T, typename std::enable_if<std::is_integral<T>::value && sizeof(T) == 4>::type> {
+
+    static const bool padded = true;
+
+    static unsigned countNotGreater(const T * keys, unsigned count, const T & key) {
+        const int flip = std::is_signed<T>::value ? 0 : std::numeric_limits<int>::min();
+        int k = static_cast<int>(key) ^ flip;
+        unsigned greater;
+#if defined(__AVX2__)
+        __m256i flipped = _mm256_set1_epi32(flip);
+        __m256i wanted = _mm256_set1_epi32(k);
+        __m256i low = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys)), flipped);
+        __m256i high = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + 8)), flipped);
+        greater = __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(low, wanted))))
+                  + __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(high, wanted))));
+#else
+        __m128i flipped = _mm_set1_epi32(flip);
+        __m128i wanted = _mm_set1_epi32(k);
+        greater = 0;
+        for(int i = 0; i < 16; i += 4) {
+            __m128i some = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(keys + i)), flipped);
+            greater += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(some, wanted))));
+        }
+#endif
+        // The padding is greater than every key but the greatest value, for which it has to be left out
+        unsigned notGreater = 16 - greater;
+        return notGreater < count ? notGreater : count;
+    }
+
+};
+
+#if defined(__AVX2__) || defined(__SSE4_2__)
+
+/**
+ * BTreeKeySearch for 64-bit integers: compares the key with all 8 keys of a BTreeNode at once, with two AVX2 or four
+ * SSE4.2 compares. Plain SSE2 has no 64-bit compare, so without SSE4.2 the scalar version is used.
+ */
+template<typename T>
+struct BTreeKeySearch<T, typename std::enable_if<std::is_integral<T>::value && sizeof(T) == 8>::type> {
+
+    static const bool padded = true;
+
+    static unsigned countNotGreater(const T * keys, unsigned count, const T & key) {
+        const long long flip = std::is_signed<T>::value ? 0 : std::numeric_limits<long long>::min();
+        long long k = static_cast<long long>(key) ^ flip;
+        unsigned greater;
+#if defined(__AVX2__)
+        __m256i flipped = _mm256_set1_epi64x(flip);
+        __m256i wanted = _mm256_set1_epi64x(k);
+        __m256i low = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys)), flipped);
+        __m256i high = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + 4)), flipped);
+        greater = __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(low, wanted))))
+                  + __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(high, wanted))));
+#else
+        __m128i flipped = _mm_set1_epi64x(flip);
+        __m128i wanted = _mm_set1_epi64x(k);
+        greater = 0;
+        for(int i = 0; i < 8; i += 2) {
+            __m128i some = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(keys + i)), flipped);
+            greater += __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(some, wanted))));
+        }
+#endif
+        unsigned notGreater = 8 - greater;
+        return notGreater < count ? notGreater : count;
+    }
+
+};
+
+#endif
+#endif
+
+// ====================================================================================================================
+
+/**
+ * BTreeNode holds the sorted keys shared by the leaves and the inner nodes of a BTree. The key array takes one cache
+ * line for 32-bit and 64-bit keys (16 and 8 keys), and at least 8 keys for any other data type.
+ * @tparam T Data type stored in the BTree.
+ *
+ * @author Vakaris Paulavičius (K20062023)
+ * @version 1.0
+ */
+template<typename T>
+struct BTreeNode {
+
+    static const unsigned capacity = 64 / sizeof(T) > 8 ? 64 / sizeof(T) : 8;
+
+    T keys[capacity];
+    unsigned count;
+    const bool leaf;
+
+    /**
+     * Constructor of a BTreeNode with no keys.
+     * @param leafIn Whether the BTreeNode is a leaf.
+     */
+    explicit BTreeNode(bool leafIn)
+            : count(0), leaf(leafIn) {
+        pad();
+    }
+
+    /**
+     * Fill the unused keys with the greatest value of T, if the key search compares whole arrays.
+     */
+    void pad() {
+        if(BTreeKeySearch<T>::padded) {
+            std::fill(keys + count, keys + capacity, std::numeric_limits<T>::max());
+        }
+    }
+
+    /**
+     * Count the keys not greater than the provided one.
+     * @param key Key to look for.
+     * @return index of the child to descend to, or of the key after it in a leaf.
+     */
+    unsigned countNotGreater(const T & key) const{
+        return BTreeKeySearch<T>::countNotGreater(keys, count, key);
+    }
+
+};
+
+/**
+ * BTreeLeaf is a BTreeNode holding elements, linked to the next leaf so that the BTree can be iterated in order.
+ */
+template<typename T>
+struct BTreeLeaf : BTreeNode<T> {
+
+    BTreeLeaf * next;
+
+    BTreeLeaf()
+            : BTreeNode<T>(true), next(nullptr) {
+    }
+
+};
+
+/**
+ * BTreeInner is a BTreeNode whose keys separate its children: keys[i] is the smallest element under children[i + 1].
+ */
+template<typename T>
+struct BTreeInner : BTreeNode<T> {
+
+    BTreeNode<T> * children[BTreeNode<T>::capacity + 1];
+
+    BTreeInner()
+            : BTreeNode<T>(false) {
+    }
+
+};
+
+// ====================================================================================================================
+
+/**
+ * BTreeIterator used to iterate over the elements of a BTree in order, leaf by leaf.
+ * @tparam T Data type stored in the BTree.
+ *
+ * @author Vakaris Paulavičius (K20062023)
+ * @version 1.0
+ */
+template<typename T>
+class BTreeIterator {
+
+private:
+
+    BTreeLeaf<T> * leaf;
+    unsigned index;
+
+public:
+
+    typedef std::forward_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const T * pointer;
+    typedef const T & reference;
+
+    /**
+     * BTreeIterator constructor.
+     * @param leafIn Leaf holding the initial element, nullptr for the end.
+     * @param indexIn Index of the initial element in the leaf.
+     */
+    BTreeIterator(BTreeLeaf<T> * leafIn, unsigned indexIn)
+            : leaf(leafIn), index(indexIn) {
+    }
+
+    /**
+     * Return data stored in the current object of the iterator. It can not be changed, since the leaf keys must stay
+     * sorted and padded for the search.
+     * @return T data of the current object.
+     */
+    const T & operator*() const{
+        return leaf->keys[index];
+    }
+
+    /**
+     * Access a member of the data stored in the current object of the iterator.
+     * @return pointer to the data of the current object.
+     */
+    const T * operator->() const{
+        return &leaf->keys[index];
+    }
+
+    /**
+     * Increment the BTreeIterator so that it points to the next element in the tree.
+     * @return this BTreeIterator.
+     */
+    BTreeIterator & operator++() {
+        if(++index == leaf->count) {
+            leaf = leaf->next;
+            index = 0;
+        }
+        return *this;
+    }
+
+    /**
+     * Increment the BTreeIterator so that it points to the next element in the tree.
+     * @return BTreeIterator pointing to the element before the increment.
+     */
+    BTreeIterator<T> operator++(int) {
+        BTreeIterator<T> itr = *this;
+        ++(*this);
+        return itr;
+    }
+
+    /**
+     * Check whether this and the provided BTreeIterator point to the same element.
+     * @param other Another BTreeIterator to compare to.
+     * @return true if they are the same, false otherwise.
+     */
+    bool operator ==(const BTreeIterator other) const{
+        return leaf == other.leaf && index == other.index;
+    }
+
+    /**
+     * Check whether this and the provided BTreeIterator point to different elements.
+     * @param other Another BTreeIterator to compare to.
+     * @return true if they are different, false otherwise.
+     */
+    bool operator !=(const BTreeIterator other) const{
+        return !(*this == other);
+    }
+
+};
+
+// ====================================================================================================================
+
+/**
+ * BTree is a B+tree: every element is kept in a leaf of up to a cache line of sorted keys, and the inner nodes above
+ * the leaves only route the search, with up to 17 (32-bit keys) or 9 (64-bit keys) children each. That makes the tree
+ * 4 to 5 times shallower than an AVL tree, and each level is searched with a few SIMD compares (SSE2 or AVX2, for
+ * integer keys) instead of following a pointer per comparison. Other data types use a scalar search.
+ * It offers the same insert/find/iterator API as BinarySearchTree, but since the elements move between leaves when
+ * they split, pointers returned by insert and find are only valid until the next insertion. Elements can not be
+ * erased. T must be default constructible.
+ * @tparam T Data type stored in the tree.
+ *
+ * @author Vakaris Paulavičius (K20062023)
+ * @version 1.0
+ */
+template<typename T>
+class BTree {
+
+private:
+
+    typedef BTreeNode<T> Node;
+    typedef BTreeLeaf<T> Leaf;
+    typedef BTreeInner<T> Inner;
+
+    static const unsigned capacity = Node::capacity;
+
+    Node * root;
+    Leaf * first;
+    size_t count;
+    int height;
+
+    // === METHODS ===
+
+    /**
+     * Split the full child of the provided inner node in two and put the key separating them into the inner node,
+     * which must not be full.
+     * @param parent Inner node.
+     * @param i Index of the child to split.
+     */
+    void splitChild(Inner * parent, unsigned i) {
+        Node * child = parent->children[i];
+        Node * right;
+        T separator;
+        if(child->leaf) {
+            // A leaf keeps its first half and a copy of the first element of the second half goes up
+            Leaf * leftLeaf = static_cast<Leaf *>(child);
+            Leaf * rightLeaf = new Leaf();
+            unsigned half = capacity / 2;
+            std::move(leftLeaf->keys + half, leftLeaf->keys + capacity, rightLeaf->keys);
+            rightLeaf->count = capacity - half;
+            leftLeaf->count = half;
+            rightLeaf->next = leftLeaf->next;
+            leftLeaf->next = rightLeaf;
+            separator = rightLeaf->keys[0];
+            right = rightLeaf;
+        }
+        else {
+            // An inner node gives up its middle key, which only routes the search, and keeps the children left of it
+            Inner * leftInner = static_cast<Inner *>(child);
+            Inner * rightInner = new Inner();
+            unsigned middle = capacity / 2;
+            separator = std::move(leftInner->keys[middle]);
+            std::move(leftInner->keys + middle + 1, leftInner->keys + capacity, rightInner->keys);
+            std::copy(leftInner->children + middle + 1, leftInner->children + capacity + 1, rightInner->children);
+            rightInner->count = capacity - middle - 1;
+            leftInner->count = middle;
+            right = rightInner;
+        }
+        child->pad();
+        right->pad();
+        std::move_backward(parent->keys + i, parent->keys + parent->count, parent->keys + parent->count + 1);
+        std::copy_backward(parent->children + i + 1, parent->children + parent->count + 1,
+                           parent->children + parent->count + 2);
+        parent->keys[i] = std::move(separator);
+        parent->children[i + 1] = right;
+        ++parent->count;
+    }
+
+    /**
+     * Insert data into the tree, splitting every full node on the way down, so that a split never has to go back up.
+     * @param data Data element which to insert.
+     * @return Pointer to the inserted element, nullptr if the data already exists in the tree.
+     */
+    template<typename U>
+    const T * insertValue(U && data) {
+        if(!root) {
+            first = new Leaf();
+            root = first;
+            height = 1;
+        }
+        if(root->count == capacity) {
+            Inner * newRoot = new Inner();
+            newRoot->children[0] = root;
+            root = newRoot;
+            splitChild(newRoot, 0);
+            ++height;
+        }
+        Node * node = root;
+        while(!node->leaf) {
+            Inner * inner = static_cast<Inner *>(node);
+            unsigned i = inner->countNotGreater(data);
+            if(inner->children[i]->count == capacity) {
+                splitChild(inner, i);
+                if(!(data < inner->keys[i])) {
+                    ++i;
+                }
+            }
+            node = inner->children[i];
+        }
+        unsigned position = node->countNotGreater(data);
+        if(position > 0 && !(node->keys[position - 1] < data)) {
+            return nullptr;
+        }
+        std::move_backward(node->keys + position, node->keys + node->count, node->keys + node->count + 1);
+        node->keys[position] = std::forward<U>(data);
+        ++node->count;
+        ++count;
+        return &node->keys[position];
+    }
+
+    /**
+     * Free a node and everything under it.
+     * @param node The node.
+     */
+    static void destroy(Node * node) {
+        if(node->leaf) {
+            delete static_cast<Leaf *>(node);
+            return;
+        }
+        Inner * inner = static_cast<Inner *>(node);
+        for(unsigned i = 0; i <= inner->count; ++i) {
+            destroy(inner->children[i]);
+        }
+        delete inner;
+    }
+
+public:
+
+    /**
+     * Default constructor of the BTree with no elements inside.
+     */
+    BTree()
+            : root(nullptr), first(nullptr), count(0), height(0) {
+    }
+
+    BTree(const BTree &) = delete;
+    BTree & operator=(const BTree &) = delete;
+
+    /**
+     * Move constructor.
+     * @param other BTree to take the elements from, left empty.
+     */
+    BTree(BTree && other)
+            : root(other.root), first(other.first), count(other.count), height(other.height) {
+        other.root = nullptr;
+        other.first = nullptr;
+        other.count = 0;
+        other.height = 0;
+    }
+
+    /**
+     * Deconstructor.
+     */
+    ~BTree() {
+        if(root) {
+            destroy(root);
+        }
+    }
+
+    /**
+     * Get the tree representation.
+     * @param o ostream object.
+     */
+    void write(ostream & o) const{
+        forEach([&](const T & data) { o << " " << data << " "; });
+    }
+
+    /**
+     * Insert element to the BTree.
+     * @param data Data element which to insert.
+     * @return Pointer to the inserted element, nullptr if the data already exists in the tree.
+     * Valid until the next insertion.
+     */
+    const T * insert(const T & data) {
+        return insertValue(data);
+    }
+
+    /**
+     * Insert element to the BTree, moving it into the leaf.
+     * @param data Data element which to insert.
+     * @return Pointer to the inserted element, nullptr if the data already exists in the tree.
+     * Valid until the next insertion.
+     */
+    const T * insert(T && data) {
+        return insertValue(std::move(data));
+    }
+
+    /**
+     * Look for the data element in the BTree.
+     * @param data Data element which to look for.
+     * @return Pointer to the element equal to the provided data, nullptr if the data does not exist in the tree.
+     * Valid until the next insertion.
+     */
+    const T * find(const T & data) const{
+        if(!root) {
+            return nullptr;
+        }
+        const Node * node = root;
+        while(!node->leaf) {
+            node = static_cast<const Inner *>(node)->children[node->countNotGreater(data)];
+        }
+        unsigned position = node->countNotGreater(data);
+        if(position > 0 && !(node->keys[position - 1] < data)) {
+            return &node->keys[position - 1];
+        }
+        return nullptr;
+    }
+
+    /**
+     * Get the number of elements in the tree.
+     * @return number of elements.
+     */
+    size_t size() const{
+        return count;
+    }
+
+    /**
+     * Get the number of levels of the BTree, O(1). Every leaf is on the same level.
+     * @return max depth of the tree, 0 if the tree is empty.
+     */
+    int maxDepth() const{
+        return height;
+    }
+
+    /**
+     * Call the function on every element in order, leaf by leaf.
+     * @param fn Function taking a const reference to an element.
+     */
+    template<typename Fn>
+    void forEach(Fn fn) const{
+        for(const Leaf * leaf = first; leaf; leaf = leaf->next) {
+            for(unsigned i = 0; i < leaf->count; ++i) {
+                fn(leaf->keys[i]);
+            }
+        }
+    }
+
+    /**
+     * Get a BTreeIterator pointing to the first element of the tree.
+     * @return BTreeIterator pointing to the beginning of the tree.
+     */
+    BTreeIterator<T> begin() {
+        return BTreeIterator<T>(first && first->count > 0 ? first : nullptr, 0);
+    }
+
+    /**
+     * Get a BTreeIterator pointing past the last element of the tree.
+     * @return BTreeIterator pointing to the end of the tree.
+     */
+    BTreeIterator<T> end() {
+        return BTreeIterator<T>(nullptr, 0);
+    }
+
+};
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef BUFFEREDSINK_H
+#define BUFFEREDSINK_H
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+/**
+ * BufferedSink collects output in a fixed-size buffer and hands it to an ostream in big blocks, so that writing a
+ * tree costs one ostream call per few thousand elements instead of a few per element. Integers are formatted by
+ * hand, everything else goes through its operator<< using the formatting flags of the ostream. A field width set on
+ * the ostream is used up by the BufferedSink, like operator<< would, and applied to every value.
+ * The buffer is taken from the heap, so that a BufferedSink is cheap to put on the stack of any thread, and is flushed
+ * when it fills up and when the BufferedSink is destroyed.
+ *
+ * @author Vakaris Paulavičius (K20062023)
+ * @version 1.0
+ */
+class BufferedSink {
+
+private:
+
+    static const size_t capacity = 1 << 16;
+
+    std::ostream & out;
+    std::unique_ptr<char[]> buffer;
+    size_t used;
+    std::streamsize width;
+    // Integers can only be formatted by hand when the ostream would print them as plain decimals with no padding
+    bool plainIntegers;
+    std::ostringstream formatted;
+
+    // === METHODS ===
+
+    /**
+     * Format an integer by hand, without going through the ostream.
+     * @param value The integer.
+     */
+    template<typename Integer>
+    void appendInteger(Integer value) {
+        typedef typename std::make_unsigned<Integer>::type Unsigned;
+        char digits[3 * sizeof(Integer) + 1];
+        char * end = digits + sizeof(digits);
+        char * start = end;
+        bool negative = value < 0;
+        // Negate in the unsigned type, so that the smallest value of a signed type does not overflow
+        Unsigned magnitude = negative ? static_cast<Unsigned>(0) - static_cast<Unsigned>(value)
+                                      : static_cast<Unsigned>(value);
+        do {
+            *--start = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while(magnitude != 0);
+        if(negative) {
+            *--start = '-';
+        }
+        append(start, static_cast<size_t>(end - start));
+    }
+
+public:
+
+    /**
+     * Constructor of a BufferedSink writing into the ostream.
+     * @param o ostream object, which must outlive the BufferedSink.
+     */
+    explicit BufferedSink(std::ostream & o)
+            : out(o), buffer(new char[capacity]), used(0), width(o.width()),
+              plainIntegers(width == 0 && ((o.flags() & (std::ios::basefield | std::ios::showpos)) == std::ios::dec
+                                           || (o.flags() & (std::ios::basefield | std::ios::showpos)) == 0)) {
+        formatted.copyfmt(o);
+        o.width(0);
+    }
+
+    BufferedSink(const BufferedSink &) = delete;
+    BufferedSink & operator=(const BufferedSink &) = delete;
+
+    /**
+     * Deconstructor, flushes what is left in the buffer.
+     */
+    ~BufferedSink() {
+        flush();
+    }
+
+    /**
+     * Hand everything in the buffer to the ostream.
+     */
+    void flush() {
+        if(used > 0) {
+            out.write(buffer.get(), static_cast<std::streamsize>(used));
+            used = 0;
+        }
+    }
+
+    /**
+     * Append characters to the output.
+     * @param characters First character.
+     * @param length Number of characters.
+     */
+    void append(const char * characters, size_t length) {
+        if(length > capacity - used) {
+            flush();
+            if(length > capacity) {
+                out.write(characters, static_cast<std::streamsize>(length));
+                return;
+            }
+        }
+        std::memcpy(buffer.get() + used, characters, length);
+        used += length;
+    }
+
+    /**
+     * Append a string to the output.
+     * @param text The string.
+     */
+    void append(const std::string & text) {
+        append(text.data(), text.size());
+    }
+
+    /**
+     * Append a character to the output.
+     * @param character The character.
+     */
+    void append(char character) {
+        if(used == capacity) {
+            flush();
+        }
+        buffer[used++] = character;
+    }
+
+    /**
+     * Append a value the way operator<< would write it to the ostream, integers being formatted by hand.
+     * @param value The value.
+     */
+    template<typename V>
+    typename std::enable_if<std::is_integral<V>::value && !std::is_same<V, bool>::value
+                            && !std::is_same<V, char>::value && !std::is_same<V, signed char>::value
+                            && !std::is_same<V, unsigned char>::value>::type
+    appendValue(const V & value) {
+        if(plainIntegers) {
+            appendInteger(value);
+        }
+        else {
+            appendFormatted(value);
+        }
+    }
+
+    template<typename V>
+    typename std::enable_if<!(std::is_integral<V>::value && !std::is_same<V, bool>::value
+                              && !std::is_same<V, char>::value && !std::is_same<V, signed char>::value
+                              && !std::is_same<V, unsigned char>::value)>::type
+    appendValue(const V & value) {
+        appendFormatted(value);
+    }
+
+    /**
+     * Append a value through its operator<<, using the formatting flags and the field width of the ostream.
+     * @param value The value.
+     */
+    template<typename V>
+    void appendFormatted(const V & value) {
+        formatted.str(std::string());
+        formatted.width(width);
+        formatted << value;
+        append(formatted.str());
+    }
+
+};
+
+/**
+ * Formatter that writes an element the way operator<< does, the default for writing a tree into a BufferedSink.
+ */
+struct StreamFormatter {
+
+    template<typename T>
+    void operator()(BufferedSink & sink, const T & data) const{
+        sink.appendValue(data);
+    }
+
+};
+
+#endif
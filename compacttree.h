@@ -0,0 +1,552 @@
+#ifndef COMPACTTREE_H
+#define COMPACTTREE_H
+
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using std::ostream;
+
+/**
+ * CompactTreeNode represents a node of a CompactBinarySearchTree.
+ * Instead of owning pointers it refers to its children and parent by their index in the tree's vector, and packs
+ * the AVL balance factor into the two top bits of the parent index, which leaves 30 bits for the index.
+ * @tparam T Data type stored in the CompactTreeNode.
+ *
+ * @author Vakaris Paulavičius (K20062023)
+ * @version 1.0
+ */
+template<typename T>
+class CompactTreeNode {
+
+public:
+
+    static const uint32_t nullIndex = 0x3FFFFFFF;
+
+    T data;
+    uint32_t leftChild;
+    uint32_t rightChild;
+
+private:
+
+    // Parent index in the low 30 bits, balance factor + 1 (left height - right height + 1) in the top 2 bits
+    uint32_t parentAndBalance;
+
+public:
+
+    /**
+     * Constructor of a balanced CompactTreeNode with no children.
+     * @param data Data to be stored in the CompactTreeNode.
+     * @param parentIndex Index of the parent, nullIndex for the root.
+     */
+    CompactTreeNode(T data, uint32_t parentIndex)
+            : data(std::move(data)), leftChild(nullIndex), rightChild(nullIndex),
+              parentAndBalance(parentIndex | (1u << 30)) {
+    }
+
+    /**
+     * Get the index of the parent.
+     * @return parent index, nullIndex for the root.
+     */
+    uint32_t parent() const{
+        return parentAndBalance & nullIndex;
+    }
+
+    /**
+     * Set the index of the parent, keeping the balance factor.
+     * @param parentIndex Index of the parent, nullIndex for the root.
+     */
+    void setParent(uint32_t parentIndex) {
+        parentAndBalance = (parentAndBalance & ~nullIndex) | parentIndex;
+    }
+
+    /**
+     * Get the balance factor, the height of the left subtree minus the height of the right one.
+     * @return balance factor, one of -1, 0, 1.
+     */
+    int balanceFactor() const{
+        return static_cast<int>(parentAndBalance >> 30) - 1;
+    }
+
+    /**
+     * Set the balance factor, keeping the parent index.
+     * @param balance One of -1, 0, 1.
+     */
+    void setBalanceFactor(int balance) {
+        parentAndBalance = (parentAndBalance & nullIndex) | (static_cast<uint32_t>(balance + 1) << 30);
+    }
+
+};
+
+template<typename T>
+const uint32_t CompactTreeNode<T>::nullIndex;
+
+// ====================================================================================================================
+
+/**
+ * CompactTreeIterator used to iterate over the CompactTreeNodes of a CompactBinarySearchTree in order.
+ * @tparam T Data type stored in the CompactTreeNodes.
+ *
+ * @author Vakaris Paulavičius (K20062023)
+ * @version 1.0
+ */
+template<typename T>
+class CompactTreeIterator {
+
+private:
+
+    const std::vector<CompactTreeNode<T> > * nodes;
+    uint32_t current;
+
+public:
+
+    typedef std::forward_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const T * pointer;
+    typedef const T & reference;
+
+    /**
+     * CompactTreeIterator constructor.
+     * @param nodesIn Vector holding the CompactTreeNodes of the tree.
+     * @param currentIn Index of the initial CompactTreeNode, nullIndex for the end.
+     */
+    CompactTreeIterator(const std::vector<CompactTreeNode<T> > * nodesIn, uint32_t currentIn)
+            : nodes(nodesIn), current(currentIn) {
+    }
+
+    /**
+     * Return data stored in the current object of the iterator. It can not be changed, since that could break the
+     * order of the tree.
+     * @return T data of the current object.
+     */
+    const T & operator*() const{
+        return (*nodes)[current].data;
+    }
+
+    /**
+     * Access a member of the data stored in the current object of the iterator.
+     * @return pointer to the data of the current object.
+     */
+    const T * operator->() const{
+        return &(*nodes)[current].data;
+    }
+
+    /**
+     * Increment the CompactTreeIterator so that it points to the next element in the tree.
+     * @return this CompactTreeIterator.
+     */
+    CompactTreeIterator & operator++() {
+        const std::vector<CompactTreeNode<T> > & n = *nodes;
+        if(n[current].rightChild != CompactTreeNode<T>::nullIndex) {
+            current = n[current].rightChild;
+            while(n[current].leftChild != CompactTreeNode<T>::nullIndex) {
+                current = n[current].leftChild;
+            }
+        }
+        else {
+            uint32_t child = current;
+            current = n[current].parent();
+            while(current != CompactTreeNode<T>::nullIndex && n[current].rightChild == child) {
+                child = current;
+                current = n[current].parent();
+            }
+        }
+        return *this;
+    }
+
+    /**
+     * Increment the CompactTreeIterator so that it points to the next element in the tree.
+     * @return CompactTreeIterator pointing to the element before the increment.
+     */
+    CompactTreeIterator<T> operator++(int) {
+        CompactTreeIterator<T> itr = *this;
+        ++(*this);
+        return itr;
+    }
+
+    /**
+     * Check whether this and the provided CompactTreeIterator point to the same CompactTreeNode.
+     * @param other Another CompactTreeIterator to compare to.
+     * @return true if they are the same, false otherwise.
+     */
+    bool operator ==(const CompactTreeIterator other) const{
+        return current == other.current;
+    }
+
+    /**
+     * Check whether this and the provided CompactTreeIterator point to different CompactTreeNodes.
+     * @param other Another CompactTreeIterator to compare to.
+     * @return true if they are different, false otherwise.
+     */
+    bool operator !=(const CompactTreeIterator other) const{
+        return current != other.current;
+    }
+
+    /**
+     * Get a pointer to the CompactTreeNode that this iterator is pointing to.
+     * @return current CompactTreeNode, nullptr at the end.
+     */
+    const CompactTreeNode<T> * getNode() const{
+        return current == CompactTreeNode<T>::nullIndex ? nullptr : &(*nodes)[current];
+    }
+
+};
+
+// ====================================================================================================================
+
+/**
+ * CompactBinarySearchTree is an AVL BinarySearchTree that keeps all of its nodes in one vector and links them with
+ * 30-bit indices, with the balance factor packed into the top two bits of the parent index, so it holds at most
+ * 2^30 - 1 elements. For small data such as int a node takes 16 bytes, about a third of a TreeNode plus its malloc
+ * overhead, and neighbouring nodes share cache lines.
+ * It offers the insert/find/iterator API of BinarySearchTree with read-only access to the elements, and since the
+ * nodes live in a vector, pointers returned by insert and find are only valid until the next insertion. Elements can
+ * not be erased.
+ * @tparam T Data type stored in the tree.
+ *
+ * @author Vakaris Paulavičius (K20062023)
+ * @version 1.0
+ */
+template<typename T>
+class CompactBinarySearchTree {
+
+private:
+
+    typedef CompactTreeNode<T> Node;
+
+    std::vector<Node> nodes;
+    uint32_t root;
+
+    // === METHODS ===
+
+    /**
+     * Put the replacement in the place of the child of the provided parent (or of the root).
+     * @param parentIndex Index of the parent, nullIndex if the child was the root.
+     * @param oldChild Index of the child being replaced.
+     * @param newChild Index of the node taking its place.
+     */
+    void replaceChild(uint32_t parentIndex, uint32_t oldChild, uint32_t newChild) {
+        nodes[newChild].setParent(parentIndex);
+        if(parentIndex == Node::nullIndex) {
+            root = newChild;
+        }
+        else if(nodes[parentIndex].leftChild == oldChild) {
+            nodes[parentIndex].leftChild = newChild;
+        }
+        else {
+            nodes[parentIndex].rightChild = newChild;
+        }
+    }
+
+    /**
+     * Set the parent of the node with the provided index, if there is such a node.
+     */
+    void setParentIfAny(uint32_t index, uint32_t parentIndex) {
+        if(index != Node::nullIndex) {
+            nodes[index].setParent(parentIndex);
+        }
+    }
+
+    /**
+     * Rotate left around x, whose right child z is right heavy. Only used after insertions, so both end balanced.
+     * @return Index of the new subtree root (z).
+     */
+    uint32_t rotateLeft(uint32_t x, uint32_t z) {
+        uint32_t innerChild = nodes[z].leftChild;
+        nodes[x].rightChild = innerChild;
+        setParentIfAny(innerChild, x);
+        replaceChild(nodes[x].parent(), x, z);
+        nodes[z].leftChild = x;
+        nodes[x].setParent(z);
+        nodes[x].setBalanceFactor(0);
+        nodes[z].setBalanceFactor(0);
+        return z;
+    }
+
+    /**
+     * Rotate right around x, whose left child z is left heavy. Only used after insertions, so both end balanced.
+     * @return Index of the new subtree root (z).
+     */
+    uint32_t rotateRight(uint32_t x, uint32_t z) {
+        uint32_t innerChild = nodes[z].rightChild;
+        nodes[x].leftChild = innerChild;
+        setParentIfAny(innerChild, x);
+        replaceChild(nodes[x].parent(), x, z);
+        nodes[z].rightChild = x;
+        nodes[x].setParent(z);
+        nodes[x].setBalanceFactor(0);
+        nodes[z].setBalanceFactor(0);
+        return z;
+    }
+
+    /**
+     * Rotate right around z and then left around x, where z is the left heavy right child of x.
+     * @return Index of the new subtree root (the left child of z).
+     */
+    uint32_t rotateRightLeft(uint32_t x, uint32_t z) {
+        uint32_t y = nodes[z].leftChild;
+        int balance = nodes[y].balanceFactor();
+        nodes[z].leftChild = nodes[y].rightChild;
+        setParentIfAny(nodes[y].rightChild, z);
+        nodes[x].rightChild = nodes[y].leftChild;
+        setParentIfAny(nodes[y].leftChild, x);
+        replaceChild(nodes[x].parent(), x, y);
+        nodes[y].rightChild = z;
+        nodes[z].setParent(y);
+        nodes[y].leftChild = x;
+        nodes[x].setParent(y);
+        nodes[x].setBalanceFactor(balance < 0 ? 1 : 0);
+        nodes[z].setBalanceFactor(balance > 0 ? -1 : 0);
+        nodes[y].setBalanceFactor(0);
+        return y;
+    }
+
+    /**
+     * Rotate left around z and then right around x, where z is the right heavy left child of x.
+     * @return Index of the new subtree root (the right child of z).
+     */
+    uint32_t rotateLeftRight(uint32_t x, uint32_t z) {
+        uint32_t y = nodes[z].rightChild;
+        int balance = nodes[y].balanceFactor();
+        nodes[z].rightChild = nodes[y].leftChild;
+        setParentIfAny(nodes[y].leftChild, z);
+        nodes[x].leftChild = nodes[y].rightChild;
+        setParentIfAny(nodes[y].rightChild, x);
+        replaceChild(nodes[x].parent(), x, y);
+        nodes[y].leftChild = z;
+        nodes[z].setParent(y);
+        nodes[y].rightChild = x;
+        nodes[x].setParent(y);
+        nodes[x].setBalanceFactor(balance > 0 ? -1 : 0);
+        nodes[z].setBalanceFactor(balance < 0 ? 1 : 0);
+        nodes[y].setBalanceFactor(0);
+        return y;
+    }
+
+    /**
+     * Walk up from the most recently inserted node, updating balance factors until a subtree keeps its height or
+     * a rotation restores it.
+     * @param child Index of the inserted node.
+     */
+    void retraceInsertion(uint32_t child) {
+        for(uint32_t node = nodes[child].parent(); node != Node::nullIndex; node = nodes[child].parent()) {
+            int balance = nodes[node].balanceFactor();
+            if(nodes[node].leftChild == child) {
+                if(balance == 1) {
+                    if(nodes[child].balanceFactor() < 0) {
+                        rotateLeftRight(node, child);
+                    }
+                    else {
+                        rotateRight(node, child);
+                    }
+                    return;
+                }
+                nodes[node].setBalanceFactor(balance + 1);
+            }
+            else {
+                if(balance == -1) {
+                    if(nodes[child].balanceFactor() > 0) {
+                        rotateRightLeft(node, child);
+                    }
+                    else {
+                        rotateLeft(node, child);
+                    }
+                    return;
+                }
+                nodes[node].setBalanceFactor(balance - 1);
+            }
+            if(balance != 0) {
+                return; // Was heavy on the other side, now balanced: the height did not change
+            }
+            child = node;
+        }
+    }
+
+    /**
+     * Insert data into the tree by walking down from the root in a loop.
+     * @tparam U Either const T & or T, so that the data can be forwarded into the node.
+     * @param data Data element to insert.
+     * @return Pointer to the data in its node or nullptr if the data already exists in the tree.
+     * @throws std::length_error if the tree already holds as many nodes as a 30-bit index can refer to.
+     */
+    template<typename U>
+    const T * insertIteratively(U && data) {
+        uint32_t parentIndex = Node::nullIndex;
+        uint32_t node = root;
+        bool left = false;
+        while(node != Node::nullIndex) {
+            parentIndex = node;
+            if(data < nodes[node].data) {
+                left = true;
+                node = nodes[node].leftChild;
+            }
+            else if(nodes[node].data < data) {
+                left = false;
+                node = nodes[node].rightChild;
+            }
+            else {
+                return nullptr; // Already exists
+            }
+        }
+        if(nodes.size() >= Node::nullIndex) {
+            throw std::length_error("CompactBinarySearchTree can not hold more than 2^30 - 1 elements");
+        }
+        uint32_t index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back(std::forward<U>(data), parentIndex);
+        if(parentIndex == Node::nullIndex) {
+            root = index;
+        }
+        else {
+            if(left) {
+                nodes[parentIndex].leftChild = index;
+            }
+            else {
+                nodes[parentIndex].rightChild = index;
+            }
+            retraceInsertion(index);
+        }
+        return &nodes[index].data;
+    }
+
+    /**
+     * Find the index of the leftmost node.
+     * @return index, nullIndex if the tree is empty.
+     */
+    uint32_t leftmost() const{
+        uint32_t node = root;
+        if(node != Node::nullIndex) {
+            while(nodes[node].leftChild != Node::nullIndex) {
+                node = nodes[node].leftChild;
+            }
+        }
+        return node;
+    }
+
+public:
+
+    /**
+     * Default constructor of the CompactBinarySearchTree with no elements inside.
+     */
+    CompactBinarySearchTree()
+            : root(Node::nullIndex) {
+    }
+
+    /**
+     * Reserve room for the provided number of elements, so that inserting them does not grow the vector.
+     * @param n Number of elements.
+     */
+    void reserve(size_t n) {
+        nodes.reserve(n);
+    }
+
+    /**
+     * Get the tree representation.
+     * @param o ostream object.
+     */
+    void write(ostream & o) const{
+        for(uint32_t node = leftmost(); node != Node::nullIndex; ) {
+            o << " " << nodes[node].data << " ";
+            if(nodes[node].rightChild != Node::nullIndex) {
+                node = nodes[node].rightChild;
+                while(nodes[node].leftChild != Node::nullIndex) {
+                    node = nodes[node].leftChild;
+                }
+            }
+            else {
+                uint32_t child = node;
+                node = nodes[node].parent();
+                while(node != Node::nullIndex && nodes[node].rightChild == child) {
+                    child = node;
+                    node = nodes[node].parent();
+                }
+            }
+        }
+    }
+
+    /**
+     * Insert element to the CompactBinarySearchTree.
+     * @param data Data element which to insert.
+     * @return Pointer to the inserted element, nullptr if the data already exists in the tree.
+     * Valid until the next insertion.
+     * @throws std::length_error if the tree already holds 2^30 - 1 elements.
+     */
+    const T * insert(const T & data) {
+        return insertIteratively(data);
+    }
+
+    /**
+     * Insert element to the CompactBinarySearchTree, moving it into the new node.
+     * @param data Data element which to insert.
+     * @return Pointer to the inserted element, nullptr if the data already exists in the tree.
+     * Valid until the next insertion.
+     * @throws std::length_error if the tree already holds 2^30 - 1 elements.
+     */
+    const T * insert(T && data) {
+        return insertIteratively(std::move(data));
+    }
+
+    /**
+     * Look for the data element in the CompactBinarySearchTree.
+     * @param data Data element which to look for.
+     * @return Pointer to the element equal to the provided data, nullptr if the data does not exist in the tree.
+     * Valid until the next insertion.
+     */
+    const T * find(const T & data) const{
+        uint32_t node = root;
+        while(node != Node::nullIndex) {
+            if(data < nodes[node].data) {
+                node = nodes[node].leftChild;
+            }
+            else if(nodes[node].data < data) {
+                node = nodes[node].rightChild;
+            }
+            else {
+                return &nodes[node].data;
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * Get the number of elements in the tree.
+     * @return number of elements.
+     */
+    size_t size() const{
+        return nodes.size();
+    }
+
+    /**
+     * Get maximum depth of the CompactBinarySearchTree by following the heavier child from the root, O(log n).
+     * @return max depth of the tree, 0 if the tree is empty.
+     */
+    int maxDepth() const{
+        int depth = 0;
+        for(uint32_t node = root; node != Node::nullIndex; ++depth) {
+            node = nodes[node].balanceFactor() < 0 ? nodes[node].rightChild : nodes[node].leftChild;
+        }
+        return depth;
+    }
+
+    /**
+     * Get a CompactTreeIterator pointing to the first element of the tree.
+     * @return CompactTreeIterator pointing to the beginning of the tree.
+     */
+    CompactTreeIterator<T> begin() const{
+        return CompactTreeIterator<T>(&nodes, leftmost());
+    }
+
+    /**
+     * Get a CompactTreeIterator pointing past the last element of the tree.
+     * @return CompactTreeIterator pointing to the end of the tree.
+     */
+    CompactTreeIterator<T> end() const{
+        return CompactTreeIterator<T>(&nodes, Node::nullIndex);
+    }
+
+};
+
+#endif
@@ -0,0 +1,720 @@
+#ifndef CONCURRENTTREEMAP_H
+#define CONCURRENTTREEMAP_H
+
+#include "treemap.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * ConcurrentTreeElement is the KeyValuePair held by a ConcurrentTreeNode. Writers copy every ConcurrentTreeNode on the
+ * path they change, so how the KeyValuePair is held decides what such a copy costs. A Value that is trivially copyable
+ * and no bigger than two pointers is kept in the ConcurrentTreeNode and copied with it. Any other Value is kept once,
+ * in a KeyValuePair behind a shared_ptr, so that copying a path costs O(log n) Key copies and reference count
+ * increments instead of O(log n) Value copies; the Key is also kept next to the pointer, so that searches do not
+ * follow it.
+ * @tparam Key Key of the KeyValuePair.
+ * @tparam Value Value of the KeyValuePair.
+ * @tparam Inline Whether the KeyValuePair is kept in the ConcurrentTreeNode.
+ *
+ * @author Vakaris Paulavičius (K20062023)
+ * @version 1.0
+ */
+template<typename Key, typename Value,
+         bool Inline = std::is_trivially_copyable<Value>::value && sizeof(Value) <= 2 * sizeof(void *)>
+class ConcurrentTreeElement {
+
+private:
+
+    KeyValuePair<Key,Value> data;
+
+public:
+
+    /**
+     * Constructor of the ConcurrentTreeElement.
+     * @param k Key.
+     * @param v Value.
+     */
+    ConcurrentTreeElement(const Key & k, const Value & v)
+            : data(k, v) {
+    }
+
+    /**
+     * Get the Key.
+     * @return the Key.
+     */
+    const Key & key() const{
+        return data.k;
+    }
+
+    /**
+     * Get the KeyValuePair.
+     * @return the KeyValuePair.
+     */
+    const KeyValuePair<Key,Value> & pair() const{
+        return data;
+    }
+
+};
+
+template<typename Key, typename Value>
+class ConcurrentTreeElement<Key, Value, false> {
+
+private:
+
+    Key k;
+    std::shared_ptr<const KeyValuePair<Key,Value> > data;
+
+public:
+
+    /**
+     * Constructor of the ConcurrentTreeElement, the only place where the Value is copied.
+     * @param kIn Key.
+     * @param v Value.
+     */
+    ConcurrentTreeElement(const Key & kIn, const Value & v)
+            : k(kIn), data(std::make_shared<const KeyValuePair<Key,Value> >(kIn, v)) {
+    }
+
+    /**
+     * Get the Key.
+     * @return the Key.
+     */
+    const Key & key() const{
+        return k;
+    }
+
+    /**
+     * Get the KeyValuePair.
+     * @return the KeyValuePair.
+     */
+    const KeyValuePair<Key,Value> & pair() const{
+        return *data;
+    }
+
+};
+
+// ====================================================================================================================
+
+/**
+ * ConcurrentTreeNode is a node of a ConcurrentTreeMap. Once a ConcurrentTreeNode is reachable from the published root
+ * it is never changed again, writers replace it with a copy instead.
+ * @tparam Key Key of the KeyValuePair.
+ * @tparam Value Value of the KeyValuePair.
+ *
+ * @author Vakaris Paulavičius (K20062023)
+ * @version 1.0
+ */
+template<typename Key, typename Value>
+class ConcurrentTreeNode {
+
+public:
+
+    ConcurrentTreeElement<Key,Value> data;
+    ConcurrentTreeNode * leftChild;
+    ConcurrentTreeNode * rightChild;
+    int height;
+    // Number of the write that created this ConcurrentTreeNode, it may only be changed during that write
+    uint64_t version;
+
+    /**
+     * Constructor of a leaf ConcurrentTreeNode.
+     * @param k Key to store.
+     * @param v Value to store.
+     * @param versionIn Number of the write creating the ConcurrentTreeNode.
+     */
+    ConcurrentTreeNode(const Key & k, const Value & v, uint64_t versionIn)
+            : data(k, v), leftChild(nullptr), rightChild(nullptr), height(1), version(versionIn) {
+    }
+
+    /**
+     * Recalculate the height of this ConcurrentTreeNode from the heights of its children.
+     */
+    void updateHeight() {
+        int leftSubtreeHeight = leftChild ? leftChild->height : 0;
+        int rightSubtreeHeight = rightChild ? rightChild->height : 0;
+        height = leftSubtreeHeight > rightSubtreeHeight? (leftSubtreeHeight + 1) : (rightSubtreeHeight + 1);
+    }
+
+    /**
+     * Get the balance factor of the ConcurrentTreeNode.
+     * @return balance factor.
+     */
+    int balanceFactor() const{
+        int leftSubtreeHeight = leftChild ? leftChild->height : 0;
+        int rightSubtreeHeight = rightChild ? rightChild->height : 0;
+        return leftSubtreeHeight - rightSubtreeHeight;
+    }
+
+};
+
+// ====================================================================================================================
+
+/**
+ * ConcurrentTreeMap is an AVL TreeMap that many threads can use at once.
+ *
+ * Readers never take a lock. A writer copies the path from the root to the TreeNodes it changes and publishes the new
+ * root atomically, so a reader always sees a complete tree. Writers are serialised by a single mutex.
+ * Replaced TreeNodes are freed in batches, once every reader that could still see them has left: readers announce
+ * themselves on counters spread over separate cache lines, and the writer waits for the counters of the old phase to
+ * drain, twice, like userspace RCU.
+ * @tparam Key Key of the KeyValuePair.
+ * @tparam Value Value of the KeyValuePair. A small trivially copyable Value is copied with every ConcurrentTreeNode a
+ * writer replaces, any other one is shared between the copies, see ConcurrentTreeElement.
+ *
+ * @author Vakaris Paulavičius (K20062023)
+ * @version 1.0
+ */
+template<typename Key, typename Value>
+class ConcurrentTreeMap {
+
+private:
+
+    typedef ConcurrentTreeNode<Key,Value> Node;
+
+    static const size_t cacheLineSize = 64;
+    static const size_t readerStripes = 64;
+    // Replaced TreeNodes are kept until there are this many, so that writers rarely wait for readers
+    static const size_t reclaimBatch = 4096;
+
+    /**
+     * Reader counters of both phases, padded so that readers on different stripes never share a cache line.
+     */
+    struct ReaderStripe {
+        std::atomic<size_t> readers[2];
+        char padding[cacheLineSize - 2 * sizeof(std::atomic<size_t>)];
+    };
+
+    /**
+     * Marks the calling thread as a reader of the ConcurrentTreeMap for as long as it lives. In debug builds the
+     * ReadGuards of a thread are also chained, so that a write from inside a read of the same ConcurrentTreeMap,
+     * which would wait for itself to leave, is caught by an assert.
+     */
+    class ReadGuard {
+
+    private:
+
+        std::atomic<size_t> & counter;
+#ifndef NDEBUG
+        const ConcurrentTreeMap & map;
+        const ReadGuard * outer;
+
+        /**
+         * Get the innermost ReadGuard of the calling thread.
+         * @return reference to it, nullptr if the thread is not reading.
+         */
+        static const ReadGuard * & innermost() {
+            static thread_local const ReadGuard * guard = nullptr;
+            return guard;
+        }
+#endif
+
+    public:
+
+        explicit ReadGuard(const ConcurrentTreeMap & mapIn)
+                : counter(mapIn.stripes[stripeOfThisThread()].readers[mapIn.phase.load()])
+#ifndef NDEBUG
+                , map(mapIn), outer(innermost())
+#endif
+        {
+            counter.fetch_add(1);
+#ifndef NDEBUG
+            innermost() = this;
+#endif
+        }
+
+        ReadGuard(const ReadGuard &) = delete;
+        ReadGuard & operator=(const ReadGuard &) = delete;
+
+        ~ReadGuard() {
+#ifndef NDEBUG
+            innermost() = outer;
+#endif
+            counter.fetch_sub(1);
+        }
+
+#ifndef NDEBUG
+        /**
+         * Check whether the calling thread is reading the ConcurrentTreeMap.
+         * @param mapIn The ConcurrentTreeMap.
+         * @return true if a ReadGuard of the thread is on it.
+         */
+        static bool isReading(const ConcurrentTreeMap & mapIn) {
+            for(const ReadGuard * guard = innermost(); guard; guard = guard->outer) {
+                if(&guard->map == &mapIn) {
+                    return true;
+                }
+            }
+            return false;
+        }
+#endif
+
+    };
+
+    std::atomic<Node *> root;
+    std::atomic<size_t> count;
+    mutable ReaderStripe stripes[readerStripes];
+    std::atomic<unsigned> phase;
+
+    std::mutex writerMutex;
+    uint64_t writeVersion;
+    std::vector<Node *> retired;
+    // ConcurrentTreeNodes created by the current write, freed again if it throws
+    std::vector<Node *> created;
+
+    // === METHODS ===
+
+    /**
+     * Get the reader stripe of the calling thread, the same one on every call.
+     * @return index of the stripe.
+     */
+    static size_t stripeOfThisThread() {
+        static thread_local size_t stripe = std::hash<std::thread::id>()(std::this_thread::get_id()) % readerStripes;
+        return stripe;
+    }
+
+    /**
+     * Wait until every reader that started before the call has left.
+     * Each of the two phases is drained once, so that a reader that picked its phase just before a flip is waited for.
+     */
+    void synchronize() {
+        for(int flip = 0; flip < 2; ++flip) {
+            unsigned oldPhase = phase.load();
+            phase.store(oldPhase ^ 1);
+            for(ReaderStripe & stripe : stripes) {
+                while(stripe.readers[oldPhase].load() != 0) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    }
+
+    /**
+     * Free the retired TreeNodes once no reader can see them any more. Only called by the writer.
+     */
+    void reclaim() {
+        synchronize();
+        for(Node * node : retired) {
+            delete node;
+        }
+        retired.clear();
+    }
+
+    /**
+     * Publish the new root and free the retired TreeNodes if there are enough of them. Only called by the writer.
+     * @param newRoot Root of the tree after the write.
+     */
+    void publish(Node * newRoot) {
+        root.store(newRoot);
+        if(retired.size() >= reclaimBatch) {
+            reclaim();
+        }
+    }
+
+    /**
+     * Create a ConcurrentTreeNode for the current write and remember it, so that it is freed if the write throws.
+     * @param args Arguments to pass to the ConcurrentTreeNode constructor.
+     * @return the new ConcurrentTreeNode.
+     */
+    template<typename... Args>
+    Node * createNode(Args && ... args) {
+        // Make room first, so that a ConcurrentTreeNode is never created without being remembered
+        created.push_back(nullptr);
+        Node * node = new Node(std::forward<Args>(args)...);
+        created.back() = node;
+        return node;
+    }
+
+    /**
+     * Get a ConcurrentTreeNode that the current write may change: the provided one if the current write created it,
+     * otherwise a copy of it, and the original is retired.
+     * @param node ConcurrentTreeNode to change.
+     * @return ConcurrentTreeNode that can be changed.
+     */
+    Node * own(Node * node) {
+        if(node->version == writeVersion) {
+            return node;
+        }
+        Node * copy = createNode(*node);
+        copy->version = writeVersion;
+        retired.push_back(node);
+        return copy;
+    }
+
+    /**
+     * Rotate the subtree so that the right child of its root becomes the root.
+     * @param node Root of the subtree, owned by the current write.
+     * @return new root of the subtree.
+     */
+    Node * rotateLeft(Node * node) {
+        Node * newRoot = own(node->rightChild);
+        node->rightChild = newRoot->leftChild;
+        newRoot->leftChild = node;
+        node->updateHeight();
+        newRoot->updateHeight();
+        return newRoot;
+    }
+
+    /**
+     * Rotate the subtree so that the left child of its root becomes the root.
+     * @param node Root of the subtree, owned by the current write.
+     * @return new root of the subtree.
+     */
+    Node * rotateRight(Node * node) {
+        Node * newRoot = own(node->leftChild);
+        node->leftChild = newRoot->rightChild;
+        newRoot->rightChild = node;
+        node->updateHeight();
+        newRoot->updateHeight();
+        return newRoot;
+    }
+
+    /**
+     * Restore the AVL property of the subtree after one of its children changed.
+     * @param node Root of the subtree, owned by the current write.
+     * @return new root of the subtree.
+     */
+    Node * balance(Node * node) {
+        node->updateHeight();
+        int balanceFactor = node->balanceFactor();
+        if(balanceFactor > 1) {
+            if(node->leftChild->balanceFactor() < 0) {
+                node->leftChild = rotateLeft(own(node->leftChild));
+            }
+            return rotateRight(node);
+        }
+        if(balanceFactor < -1) {
+            if(node->rightChild->balanceFactor() > 0) {
+                node->rightChild = rotateRight(own(node->rightChild));
+            }
+            return rotateLeft(node);
+        }
+        return node;
+    }
+
+    /**
+     * Insert the KeyValuePair into the subtree, copying the path to it.
+     * @param node Root of the subtree.
+     * @param k Key to insert.
+     * @param v Value to insert.
+     * @param assign Whether to replace the Value if the Key is already there.
+     * @param inserted Set to true if the Key was not there.
+     * @return new root of the subtree, the same one if nothing changed.
+     */
+    Node * insertInto(Node * node, const Key & k, const Value & v, bool assign, bool & inserted) {
+        if(!node) {
+            inserted = true;
+            return createNode(k, v, writeVersion);
+        }
+        if(k < node->data.key()) {
+            Node * newChild = insertInto(node->leftChild, k, v, assign, inserted);
+            if(newChild == node->leftChild) {
+                return node;
+            }
+            Node * copy = own(node);
+            copy->leftChild = newChild;
+            return balance(copy);
+        }
+        if(node->data.key() < k) {
+            Node * newChild = insertInto(node->rightChild, k, v, assign, inserted);
+            if(newChild == node->rightChild) {
+                return node;
+            }
+            Node * copy = own(node);
+            copy->rightChild = newChild;
+            return balance(copy);
+        }
+        if(!assign) {
+            return node;
+        }
+        Node * replacement = createNode(node->data.key(), v, writeVersion);
+        replacement->leftChild = node->leftChild;
+        replacement->rightChild = node->rightChild;
+        replacement->height = node->height;
+        retired.push_back(node);
+        return replacement;
+    }
+
+    /**
+     * Remove the smallest ConcurrentTreeNode from the subtree, copying the path to it.
+     * @param node Root of the subtree, not nullptr.
+     * @param smallest Set to the removed ConcurrentTreeNode, which is not retired.
+     * @return new root of the subtree.
+     */
+    Node * removeSmallest(Node * node, Node * & smallest) {
+        if(!node->leftChild) {
+            smallest = node;
+            return node->rightChild;
+        }
+        Node * newChild = removeSmallest(node->leftChild, smallest);
+        Node * copy = own(node);
+        copy->leftChild = newChild;
+        return balance(copy);
+    }
+
+    /**
+     * Remove the Key from the subtree, copying the path to it.
+     * @param node Root of the subtree.
+     * @param k Key to remove.
+     * @param erased Set to true if the Key was there.
+     * @return new root of the subtree, the same one if nothing changed.
+     */
+    Node * eraseFrom(Node * node, const Key & k, bool & erased) {
+        if(!node) {
+            return nullptr;
+        }
+        if(k < node->data.key()) {
+            Node * newChild = eraseFrom(node->leftChild, k, erased);
+            if(!erased) {
+                return node;
+            }
+            Node * copy = own(node);
+            copy->leftChild = newChild;
+            return balance(copy);
+        }
+        if(node->data.key() < k) {
+            Node * newChild = eraseFrom(node->rightChild, k, erased);
+            if(!erased) {
+                return node;
+            }
+            Node * copy = own(node);
+            copy->rightChild = newChild;
+            return balance(copy);
+        }
+        erased = true;
+        retired.push_back(node);
+        if(!node->leftChild) {
+            return node->rightChild;
+        }
+        if(!node->rightChild) {
+            return node->leftChild;
+        }
+        Node * smallest = nullptr;
+        Node * newRightChild = removeSmallest(node->rightChild, smallest);
+        Node * successor = own(smallest);
+        successor->leftChild = node->leftChild;
+        successor->rightChild = newRightChild;
+        return balance(successor);
+    }
+
+    /**
+     * Compute the new root for one write. If the write throws, the TreeNodes it retired are still part of the
+     * published tree, so they are taken off the retired list again, and the TreeNodes it created are freed, since
+     * no reader has seen them.
+     * @param write Function returning the new root.
+     * @return new root.
+     */
+    template<typename Write>
+    Node * change(Write write) {
+        assert(!ReadGuard::isReading(*this) && "a ConcurrentTreeMap can not be written from inside one of its reads");
+        ++writeVersion;
+        size_t retiredBefore = retired.size();
+        created.clear();
+        try {
+            return write();
+        }
+        catch(...) {
+            retired.resize(retiredBefore);
+            for(Node * node : created) {
+                delete node;
+            }
+            created.clear();
+            throw;
+        }
+    }
+
+    /**
+     * Find the ConcurrentTreeNode with the Key. Must be called by a reader or by the writer.
+     * @param k Key to look for.
+     * @return the ConcurrentTreeNode, nullptr if the Key is not there.
+     */
+    const Node * findNode(const Key & k) const{
+        const Node * node = root.load();
+        while(node) {
+            if(k < node->data.key()) {
+                node = node->leftChild;
+            }
+            else if(node->data.key() < k) {
+                node = node->rightChild;
+            }
+            else {
+                return node;
+            }
+        }
+        return nullptr;
+    }
+
+public:
+
+    /**
+     * Default constructor of the ConcurrentTreeMap with no elements inside.
+     */
+    ConcurrentTreeMap()
+            : root(nullptr), count(0), phase(0), writeVersion(0) {
+        for(ReaderStripe & stripe : stripes) {
+            stripe.readers[0].store(0);
+            stripe.readers[1].store(0);
+        }
+    }
+
+    ConcurrentTreeMap(const ConcurrentTreeMap &) = delete;
+    ConcurrentTreeMap & operator=(const ConcurrentTreeMap &) = delete;
+
+    /**
+     * Look for the Key and copy its Value out. Never blocks, even while a writer is busy.
+     * @param k Key to look for.
+     * @param v Set to the Value of the Key if it was found.
+     * @return true if the Key was found, false otherwise.
+     */
+    bool find(const Key & k, Value & v) const{
+        ReadGuard guard(*this);
+        const Node * node = findNode(k);
+        if(node) {
+            v = node->data.pair().v;
+        }
+        return node != nullptr;
+    }
+
+    /**
+     * Look for the Key and call the function on its Value without copying it. Never blocks.
+     * The reference must not be kept after the function returns. The function must not write to this
+     * ConcurrentTreeMap: the write would wait for the read it is part of to end, which is asserted in debug builds.
+     * @param k Key to look for.
+     * @param fn Function taking a const reference to the Value.
+     * @return true if the Key was found, false otherwise.
+     */
+    template<typename Fn>
+    bool visit(const Key & k, Fn fn) const{
+        ReadGuard guard(*this);
+        const Node * node = findNode(k);
+        if(node) {
+            fn(node->data.pair().v);
+        }
+        return node != nullptr;
+    }
+
+    /**
+     * Check whether the Key is in the ConcurrentTreeMap. Never blocks.
+     * @param k Key to look for.
+     * @return true if the Key was found, false otherwise.
+     */
+    bool contains(const Key & k) const{
+        ReadGuard guard(*this);
+        return findNode(k) != nullptr;
+    }
+
+    /**
+     * Call the function on every KeyValuePair in order of the Keys. Never blocks.
+     * The function sees one consistent version of the ConcurrentTreeMap, whatever the writers do in the meantime. It
+     * must not write to this ConcurrentTreeMap: the write would wait for the read it is part of to end, which is
+     * asserted in debug builds.
+     * @param fn Function taking a const reference to a KeyValuePair.
+     */
+    template<typename Fn>
+    void forEach(Fn fn) const{
+        ReadGuard guard(*this);
+        forEachInOrder(static_cast<const Node *>(root.load()), [&](const Node * node) { fn(node->data.pair()); });
+    }
+
+    /**
+     * Get the number of KeyValuePairs.
+     * @return number of KeyValuePairs.
+     */
+    size_t size() const{
+        return count.load();
+    }
+
+    /**
+     * Insert the KeyValuePair if the Key is not there yet. Waits for other writers, but not for readers.
+     * @param k Key to insert.
+     * @param v Value to insert.
+     * @return true if the KeyValuePair was inserted, false if the Key was already there.
+     */
+    bool insert(const Key & k, const Value & v) {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        bool inserted = false;
+        Node * newRoot = change([&]() { return insertInto(root.load(), k, v, false, inserted); });
+        if(inserted) {
+            count.fetch_add(1);
+            publish(newRoot);
+        }
+        return inserted;
+    }
+
+    /**
+     * Insert the KeyValuePair, or replace the Value if the Key is already there.
+     * @param k Key to insert.
+     * @param v Value to insert.
+     * @return true if the KeyValuePair was inserted, false if the Value was replaced.
+     */
+    bool insert_or_assign(const Key & k, const Value & v) {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        bool inserted = false;
+        Node * newRoot = change([&]() { return insertInto(root.load(), k, v, true, inserted); });
+        if(inserted) {
+            count.fetch_add(1);
+        }
+        publish(newRoot);
+        return inserted;
+    }
+
+    /**
+     * Remove the KeyValuePair with the provided Key.
+     * @param k Key to remove.
+     * @return true if the Key was found and removed, false otherwise.
+     */
+    bool erase(const Key & k) {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        bool erased = false;
+        Node * newRoot = change([&]() { return eraseFrom(root.load(), k, erased); });
+        if(erased) {
+            count.fetch_sub(1);
+            publish(newRoot);
+        }
+        return erased;
+    }
+
+    /**
+     * Get the max depth of the tree.
+     * @return max depth.
+     */
+    int maxDepth() const{
+        ReadGuard guard(*this);
+        const Node * node = root.load();
+        return node ? node->height : 0;
+    }
+
+    /**
+     * Deconstructor, no other thread may use the ConcurrentTreeMap any more.
+     */
+    ~ConcurrentTreeMap() {
+        for(Node * node : retired) {
+            delete node;
+        }
+        std::vector<Node *> stack;
+        if(root.load()) {
+            stack.push_back(root.load());
+        }
+        while(!stack.empty()) {
+            Node * node = stack.back();
+            stack.pop_back();
+            if(node->leftChild) {
+                stack.push_back(node->leftChild);
+            }
+            if(node->rightChild) {
+                stack.push_back(node->rightChild);
+            }
+            delete node;
+        }
+    }
+
+};
+
+#endif
@@ -0,0 +1,220 @@
+#ifndef FROZENTREE_H
+#define FROZENTREE_H
+
+#include "treecompare.h"
+
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+using std::ostream;
+
+/**
+ * FrozenBinarySearchTree is an immutable copy of a BinarySearchTree (see BinarySearchTree::freeze) that keeps its
+ * elements in one array in Eytzinger order: the root at index 1 and the children of index k at 2k and 2k + 1, so a
+ * search reads the array from the front and the first levels of every search share the same few cache lines.
+ * find and lower_bound descend without a branch per level, the index of the next element being computed from the
+ * comparison, and prefetch the cache line holding the descendants a few levels further down, so the memory latency
+ * of the deep levels overlaps instead of adding up.
+ * @tparam T Data type stored in the tree, copied once when freezing.
+ * @tparam Compare Ordering of the elements, the one of the BinarySearchTree that was frozen.
+ *
+ * @author Vakaris Paulavičius (K20062023)
+ * @version 1.0
+ */
+template<typename T, typename Compare = TreeLess>
+class FrozenBinarySearchTree {
+
+private:
+
+    // Index 0 holds a copy of the smallest element so that T needs no default constructor, it is never searched
+    std::vector<T> elements;
+    size_t count;
+    Compare comparator;
+
+    // === METHODS ===
+
+    /**
+     * Give every index of the subtree rooted at k its rank in order, in O(n).
+     * @param k Index of the root of the subtree.
+     * @param nextRank Rank of the smallest element of the subtree, advanced past the greatest one.
+     * @param ranks Rank of the element at each index.
+     */
+    static void assignRanks(size_t k, size_t & nextRank, std::vector<size_t> & ranks) {
+        if(k >= ranks.size()) {
+            return;
+        }
+        assignRanks(2 * k, nextRank, ranks);
+        ranks[k] = nextRank++;
+        assignRanks(2 * k + 1, nextRank, ranks);
+    }
+
+    /**
+     * Prefetch the elements the search reaches four levels below index k: descendants 2^4 k to 2^4 k + 15
+     * lie next to each other, which is one cache line for 4-byte elements.
+     * @param k Index of the current element.
+     */
+    void prefetchBelow(size_t k) const{
+#if defined(__GNUC__)
+        // The address may be past the end of the array, which is harmless for a prefetch
+        __builtin_prefetch(reinterpret_cast<const char *>(elements.data()) + 16 * k * sizeof(T));
+#else
+        (void) k;
+#endif
+    }
+
+    /**
+     * Find the index of the first element not smaller than the key, by descending to a leaf and undoing the last
+     * turns to the right.
+     * @param key Data element, or anything that can be compared with T.
+     * @return index of the element, 0 if every element is smaller than the key.
+     */
+    template<typename K>
+    size_t lowerBoundIndex(const K & key) const{
+        const T * base = elements.data();
+        size_t k = 1;
+        while(k <= count) {
+            prefetchBelow(k);
+            k = 2 * k + static_cast<size_t>(comparator(base[k], key));
+        }
+        // Every turn to the right appended a 1 bit; the answer is where the last turn to the left happened
+#if defined(__GNUC__)
+        k >>= __builtin_ffsll(static_cast<long long>(~k));
+#else
+        while(k & 1) {
+            k >>= 1;
+        }
+        k >>= 1;
+#endif
+        return k;
+    }
+
+public:
+
+    /**
+     * Default constructor of the FrozenBinarySearchTree with no elements inside.
+     */
+    FrozenBinarySearchTree()
+            : count(0) {
+    }
+
+    /**
+     * Constructor of a FrozenBinarySearchTree with no elements inside that orders them with the provided Compare.
+     * @param comp Ordering of the elements.
+     */
+    explicit FrozenBinarySearchTree(const Compare & comp)
+            : count(0), comparator(comp) {
+    }
+
+    /**
+     * Build a FrozenBinarySearchTree out of a sorted sequence of distinct elements in O(n).
+     * @param first Iterator to the first element.
+     * @param last Iterator past the last element.
+     * @param comp Ordering the sequence is sorted by.
+     */
+    template<typename Iterator>
+    FrozenBinarySearchTree(Iterator first, Iterator last, const Compare & comp = Compare())
+            : count(0), comparator(comp) {
+        std::vector<const T *> sorted;
+        for(; first != last; ++first) {
+            sorted.push_back(&*first);
+        }
+        count = sorted.size();
+        if(count == 0) {
+            return;
+        }
+        std::vector<size_t> ranks(count + 1);
+        size_t nextRank = 0;
+        assignRanks(1, nextRank, ranks);
+        elements.reserve(count + 1);
+        elements.push_back(*sorted[0]);
+        for(size_t k = 1; k <= count; ++k) {
+            elements.push_back(*sorted[ranks[k]]);
+        }
+    }
+
+    /**
+     * Look for the element, without a branch per level.
+     * @param key Data element, or anything that can be compared with T.
+     * @return pointer to the element, nullptr if it is not there.
+     */
+    template<typename K>
+    const T * find(const K & key) const{
+        size_t k = lowerBoundIndex(key);
+        if(k == 0 || comparator(key, elements[k])) {
+            return nullptr;
+        }
+        return &elements[k];
+    }
+
+    /**
+     * Find the first element not smaller than the key, without a branch per level.
+     * @param key Data element, or anything that can be compared with T.
+     * @return pointer to the element, nullptr if every element is smaller than the key.
+     */
+    template<typename K>
+    const T * lower_bound(const K & key) const{
+        size_t k = lowerBoundIndex(key);
+        return k == 0 ? nullptr : &elements[k];
+    }
+
+    /**
+     * Check whether the element is in the tree.
+     * @param key Data element, or anything that can be compared with T.
+     * @return true if it is there.
+     */
+    template<typename K>
+    bool contains(const K & key) const{
+        return find(key) != nullptr;
+    }
+
+    /**
+     * Get the number of elements in O(1).
+     * @return number of elements.
+     */
+    size_t size() const{
+        return count;
+    }
+
+    /**
+     * Call the function on every element in order, walking the implicit tree by index arithmetic.
+     * @param fn Function taking a const reference to an element.
+     */
+    template<typename Fn>
+    void forEach(Fn fn) const{
+        if(count == 0) {
+            return;
+        }
+        size_t k = 1;
+        while(2 * k <= count) {
+            k = 2 * k;
+        }
+        while(k != 0) {
+            fn(elements[k]);
+            if(2 * k + 1 <= count) {
+                k = 2 * k + 1;
+                while(2 * k <= count) {
+                    k = 2 * k;
+                }
+            }
+            else {
+                // Climb out of right children, the parent of the first left child is next
+                while(k & 1) {
+                    k >>= 1;
+                }
+                k >>= 1;
+            }
+        }
+    }
+
+    /**
+     * Get the tree representation.
+     * @param o ostream object.
+     */
+    void write(ostream & o) const{
+        forEach([&](const T & data) { o << " " << data << " "; });
+    }
+
+};
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef MAPPEDTREEMAP_H
+#define MAPPEDTREEMAP_H
+
+#include "treemap.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAPPEDTREEMAP_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define MAPPEDTREEMAP_HAS_MMAP 0
+#endif
+
+/**
+ * MappedTreeMap serves lookups straight from a binary snapshot written by TreeMap::writeBinary, without building any
+ * TreeNodes. The file is mapped read-only into memory with mmap where it is available (the pages are loaded on first
+ * use and shared with the page cache), otherwise it is read into memory once. Since the snapshot holds the Keys in
+ * order in one array, find is a binary search over it in O(log n).
+ * @tparam Key Key of the snapshot, must be trivially copyable.
+ * @tparam Value Value of the snapshot, must be trivially copyable.
+ * @tparam Compare Ordering of the Keys, the one of the TreeMap that wrote the snapshot.
+ *
+ * @author Vakaris Paulavičius (K20062023)
+ * @version 1.0
+ */
+template<typename Key, typename Value, typename Compare = TreeLess>
+class MappedTreeMap {
+
+    static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+                  "MappedTreeMap needs trivially copyable Keys and Values");
+
+private:
+
+    const Key * keys;
+    const Value * values;
+    size_t count;
+    Compare comparator;
+
+    // Start and length of the mapping, if the file was mapped
+    void * mapping;
+    size_t mappingLength;
+    // Copy of the file, if it could not be mapped; max_align_t keeps the Key and Value arrays aligned
+    std::vector<std::max_align_t> buffer;
+
+    // === METHODS ===
+
+    /**
+     * Check the header of the image and point the Key and Value arrays into it. The Keys must be strictly increasing,
+     * like TreeMap::readBinary checks, since find binary searches them; this reads the whole Key array once.
+     * @param image Start of the snapshot in memory.
+     * @param length Number of bytes in the snapshot.
+     * @return true if the snapshot is valid for this Key and Value.
+     */
+    bool attach(const char * image, size_t length) {
+        TreeMapFileHeader header;
+        if(length < sizeof(header)) {
+            return false;
+        }
+        std::memcpy(&header, image, sizeof(header));
+        if(!header.isValid(sizeof(Key), sizeof(Value), length)) {
+            return false;
+        }
+        const Key * imageKeys = reinterpret_cast<const Key *>(image + header.keysOffset);
+        size_t imageCount = static_cast<size_t>(header.count);
+        if(std::adjacent_find(imageKeys, imageKeys + imageCount,
+                              [this](const Key & a, const Key & b) { return !comparator(a, b); })
+           != imageKeys + imageCount) {
+            return false;
+        }
+        keys = imageKeys;
+        values = reinterpret_cast<const Value *>(image + header.valuesOffset);
+        count = imageCount;
+        return true;
+    }
+
+    /**
+     * Map the file into memory with mmap.
+     * @param path Path of the file.
+     * @param valid Set to true if the mapped file is a valid snapshot.
+     * @return true if the file could be mapped, whether or not it is a valid snapshot.
+     */
+    bool map(const char * path, bool & valid) {
+        valid = false;
+#if MAPPEDTREEMAP_HAS_MMAP
+        int descriptor = ::open(path, O_RDONLY);
+        if(descriptor < 0) {
+            return false;
+        }
+        struct stat status;
+        if(::fstat(descriptor, &status) != 0 || status.st_size <= 0) {
+            ::close(descriptor);
+            return false;
+        }
+        size_t length = static_cast<size_t>(status.st_size);
+        void * address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        // The mapping stays valid after the descriptor is closed
+        ::close(descriptor);
+        if(address == MAP_FAILED) {
+            return false;
+        }
+        mapping = address;
+        mappingLength = length;
+        valid = attach(static_cast<const char *>(address), length);
+        return true;
+#else
+        (void) path;
+        return false;
+#endif
+    }
+
+    /**
+     * Read the whole file into memory, for when it cannot be mapped.
+     * @param path Path of the file.
+     * @return true if the file was read and is a valid snapshot.
+     */
+    bool load(const char * path) {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if(!in) {
+            return false;
+        }
+        std::streamoff length = in.tellg();
+        if(length <= 0) {
+            return false;
+        }
+        buffer.resize((static_cast<size_t>(length) + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t));
+        char * image = reinterpret_cast<char *>(buffer.data());
+        if(!in.seekg(0) || !in.read(image, length)) {
+            return false;
+        }
+        return attach(image, static_cast<size_t>(length));
+    }
+
+public:
+
+    /**
+     * Default constructor of a MappedTreeMap with no snapshot open.
+     * @param comp Ordering of the Keys.
+     */
+    explicit MappedTreeMap(const Compare & comp = Compare())
+            : keys(nullptr), values(nullptr), count(0), comparator(comp), mapping(nullptr), mappingLength(0) {
+    }
+
+    MappedTreeMap(const MappedTreeMap &) = delete;
+    MappedTreeMap & operator=(const MappedTreeMap &) = delete;
+
+    /**
+     * Move constructor, the snapshot stays where it is in memory and is taken over.
+     * @param other MappedTreeMap to take the snapshot from, left closed.
+     */
+    MappedTreeMap(MappedTreeMap && other)
+            : keys(other.keys), values(other.values), count(other.count), comparator(other.comparator),
+              mapping(other.mapping),
+              mappingLength(other.mappingLength), buffer(std::move(other.buffer)) {
+        other.keys = nullptr;
+        other.values = nullptr;
+        other.count = 0;
+        other.mapping = nullptr;
+        other.mappingLength = 0;
+    }
+
+    /**
+     * Deconstructor, unmaps the snapshot.
+     */
+    ~MappedTreeMap() {
+        close();
+    }
+
+    /**
+     * Open a snapshot written by TreeMap::writeBinary, closing the one open before. The file is mapped into memory
+     * if possible, otherwise it is read into memory.
+     * @param path Path of the file.
+     * @return true if the file is a valid snapshot for this Key and Value, false (and nothing is open) otherwise.
+     */
+    bool open(const char * path) {
+        close();
+        bool valid;
+        if(map(path, valid)) {
+            if(valid) {
+                return true;
+            }
+            // Reading the file instead would fail the same checks
+            close();
+            return false;
+        }
+        close();
+        if(load(path)) {
+            return true;
+        }
+        close();
+        return false;
+    }
+
+    /**
+     * Close the snapshot, after which the MappedTreeMap is empty. Pointers returned by find are no longer valid.
+     */
+    void close() {
+#if MAPPEDTREEMAP_HAS_MMAP
+        if(mapping) {
+            ::munmap(mapping, mappingLength);
+        }
+#endif
+        mapping = nullptr;
+        mappingLength = 0;
+        std::vector<std::max_align_t>().swap(buffer);
+        keys = nullptr;
+        values = nullptr;
+        count = 0;
+    }
+
+    /**
+     * Check whether a snapshot is open.
+     * @return true if open succeeded and close has not been called since.
+     */
+    bool isOpen() const{
+        return keys != nullptr;
+    }
+
+    /**
+     * Look for the Key in the snapshot in O(log n).
+     * @param k Key to look for.
+     * @return Pointer to the Value inside the snapshot, valid until it is closed, nullptr if the Key is not there.
+     */
+    const Value * find(const Key & k) const{
+        const Key * position = std::lower_bound(keys, keys + count, k, comparator);
+        if(position == keys + count || comparator(k, *position)) {
+            return nullptr;
+        }
+        return values + (position - keys);
+    }
+
+    /**
+     * Get the number of KeyValuePairs in the snapshot, in O(1).
+     * @return number of KeyValuePairs.
+     */
+    size_t size() const{
+        return count;
+    }
+
+    /**
+     * Call the function on every Key and its Value in order of the Keys.
+     * @param fn Function taking a const reference to a Key and a const reference to its Value.
+     */
+    template<typename Fn>
+    void forEach(Fn fn) const{
+        for(size_t i = 0; i < count; ++i) {
+            fn(keys[i], values[i]);
+        }
+    }
+
+};
+
+#endif
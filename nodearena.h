@@ -0,0 +1,273 @@
+#ifndef NODEARENA_H
+#define NODEARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/**
+ * NodeArena hands out memory from large contiguous blocks and keeps freed slots on free lists, one per slot size.
+ * Nothing is returned to the system until the NodeArena itself is destroyed, which frees every block at once.
+ * NodeArena is not thread-safe.
+ *
+ * @author Vakaris Paulavičius (K20062023)
+ * @version 1.0
+ */
+class NodeArena {
+
+private:
+
+    /**
+     * A freed slot, reused to link the free list it is on.
+     */
+    struct FreeSlot {
+        FreeSlot * next;
+    };
+
+    /**
+     * Free slots of one size.
+     */
+    struct FreeList {
+        size_t size;
+        FreeSlot * head;
+    };
+
+    static const size_t blockSize = 64 * 1024;
+    static const size_t alignment = alignof(std::max_align_t);
+
+    std::vector<char *> blocks;
+    std::vector<FreeList> freeLists;
+    char * current;
+    size_t remaining;
+
+    /**
+     * Round the size up so that every slot handed out is suitably aligned and can hold a FreeSlot.
+     * @param bytes Requested size.
+     * @return Size of the slot to use.
+     */
+    static size_t slotSize(size_t bytes) {
+        if(bytes < sizeof(FreeSlot)) {
+            bytes = sizeof(FreeSlot);
+        }
+        return (bytes + alignment - 1) / alignment * alignment;
+    }
+
+    /**
+     * Find the free list for slots of the provided size, creating it if needed.
+     * @param size Slot size.
+     * @return The FreeList.
+     */
+    FreeList & freeListFor(size_t size) {
+        for(FreeList & list : freeLists) {
+            if(list.size == size) {
+                return list;
+            }
+        }
+        freeLists.push_back(FreeList{size, nullptr});
+        return freeLists.back();
+    }
+
+public:
+
+    /**
+     * Constructor of an empty NodeArena, no memory is taken until the first allocation.
+     */
+    NodeArena()
+            : current(nullptr), remaining(0) {
+    }
+
+    NodeArena(const NodeArena &) = delete;
+    NodeArena & operator=(const NodeArena &) = delete;
+
+    /**
+     * Get memory for an object of the provided size, reusing a freed slot of the same size if there is one.
+     * @param bytes Size of the object.
+     * @return Pointer to the memory.
+     */
+    void * allocate(size_t bytes) {
+        size_t size = slotSize(bytes);
+        FreeList & list = freeListFor(size);
+        if(list.head) {
+            FreeSlot * slot = list.head;
+            list.head = slot->next;
+            return slot;
+        }
+        if(remaining < size) {
+            size_t newBlockSize = size > blockSize ? size : blockSize;
+            blocks.push_back(static_cast<char *>(::operator new(newBlockSize)));
+            current = blocks.back();
+            remaining = newBlockSize;
+        }
+        void * toReturn = current;
+        current += size;
+        remaining -= size;
+        return toReturn;
+    }
+
+    /**
+     * Put the memory back on the free list of its size so that the next allocation of that size can reuse it.
+     * @param pointer Memory returned by allocate.
+     * @param bytes Size that was passed to allocate.
+     */
+    void deallocate(void * pointer, size_t bytes) {
+        FreeList & list = freeListFor(slotSize(bytes));
+        FreeSlot * slot = static_cast<FreeSlot *>(pointer);
+        slot->next = list.head;
+        list.head = slot;
+    }
+
+    /**
+     * Get the number of blocks taken from the system so far.
+     * @return number of blocks.
+     */
+    size_t blockCount() const{
+        return blocks.size();
+    }
+
+    /**
+     * Deconstructor, frees every block in one go.
+     */
+    ~NodeArena() {
+        for(char * block : blocks) {
+            ::operator delete(block);
+        }
+    }
+
+};
+
+// ====================================================================================================================
+
+/**
+ * ArenaAllocator is a standard allocator that takes its memory from a NodeArena.
+ * Copies of an ArenaAllocator (including rebound ones) share the same NodeArena, which lives as long as the last of
+ * them. A default constructed ArenaAllocator creates a new NodeArena.
+ * @tparam T Type of the objects to allocate.
+ *
+ * @author Vakaris Paulavičius (K20062023)
+ * @version 1.0
+ */
+template<typename T>
+class ArenaAllocator {
+
+    template<typename U>
+    friend class ArenaAllocator;
+
+private:
+
+    std::shared_ptr<NodeArena> arena;
+
+public:
+
+    typedef T value_type;
+    // Containers hand their NodeArena over together with their elements
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    /**
+     * Constructor of the ArenaAllocator with a new NodeArena.
+     */
+    ArenaAllocator()
+            : arena(std::make_shared<NodeArena>()) {
+    }
+
+    /**
+     * Constructor of the ArenaAllocator that shares the NodeArena of another one.
+     * @param other ArenaAllocator whose NodeArena to use.
+     */
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> & other)
+            : arena(other.arena) {
+    }
+
+    /**
+     * Get memory for n objects.
+     * @param n Number of objects.
+     * @return Pointer to the memory.
+     */
+    T * allocate(size_t n) {
+        return static_cast<T *>(arena->allocate(n * sizeof(T)));
+    }
+
+    /**
+     * Give back memory for n objects.
+     * @param pointer Memory returned by allocate.
+     * @param n Number of objects that was passed to allocate.
+     */
+    void deallocate(T * pointer, size_t n) {
+        arena->deallocate(pointer, n * sizeof(T));
+    }
+
+    /**
+     * Get the NodeArena this ArenaAllocator takes its memory from.
+     * @return the NodeArena.
+     */
+    NodeArena & getArena() const{
+        return *arena;
+    }
+
+    /**
+     * Check whether this is the only ArenaAllocator left using its NodeArena, which is then freed together with it.
+     * @return true if no other ArenaAllocator shares the NodeArena.
+     */
+    bool isLastUser() const{
+        return arena.use_count() == 1;
+    }
+
+    /**
+     * Check whether memory from one of the ArenaAllocators can be given back through the other one.
+     * @param other ArenaAllocator to compare to.
+     * @return true if both use the same NodeArena.
+     */
+    template<typename U>
+    bool operator ==(const ArenaAllocator<U> & other) const{
+        return arena == other.arena;
+    }
+
+    /**
+     * Check whether memory from one of the ArenaAllocators can not be given back through the other one.
+     * @param other ArenaAllocator to compare to.
+     * @return true if they use different NodeArenas.
+     */
+    template<typename U>
+    bool operator !=(const ArenaAllocator<U> & other) const{
+        return arena != other.arena;
+    }
+
+};
+
+/**
+ * Tells whether an allocator frees all of its memory in bulk when it goes away, so that a container holding
+ * trivially destructible data can skip giving back every element one by one.
+ * @tparam Allocator Allocator type.
+ */
+template<typename Allocator>
+struct AllocatorFreesInBulk : std::false_type {
+
+    /**
+     * Check whether everything taken through the allocator is freed when this copy of it goes away.
+     * @return false, the memory of other allocators has to be given back one by one.
+     */
+    static bool whenDestroyed(const Allocator &) {
+        return false;
+    }
+
+};
+
+template<typename T>
+struct AllocatorFreesInBulk<ArenaAllocator<T> > : std::true_type {
+
+    /**
+     * Check whether everything taken through the ArenaAllocator is freed when this copy of it goes away. Copies
+     * share the NodeArena, and while another one (or another tree) uses it, memory left behind would stay taken.
+     * @param allocator The ArenaAllocator.
+     * @return true if it is the last user of its NodeArena.
+     */
+    static bool whenDestroyed(const ArenaAllocator<T> & allocator) {
+        return allocator.isLastUser();
+    }
+
+};
+
+#endif
@@ -0,0 +1,311 @@
+#ifndef PERSISTENTTREE_H
+#define PERSISTENTTREE_H
+
+#include "treenode.h"
+
+#include <iostream>
+using std::ostream;
+
+#include <memory>
+
+/**
+ * PersistentTreeNode is a node of a PersistentBinarySearchTree. It never changes after it is made, so it can be shared
+ * by any number of versions of the tree, and it is freed together with the last version that uses it.
+ * @tparam T Data type stored in the PersistentTreeNode.
+ *
+ * @author Vakaris Paulavičius (K20062023)
+ * @version 1.0
+ */
+template<typename T>
+class PersistentTreeNode {
+
+public:
+
+    typedef std::shared_ptr<const PersistentTreeNode> Pointer;
+
+    const T data;
+    const Pointer leftChild;
+    const Pointer rightChild;
+    const int height;
+    const size_t size;
+
+    /**
+     * PersistentTreeNode constructor, the height and size are calculated from the children.
+     * @param dataIn Data to store.
+     * @param leftChildIn Left subtree.
+     * @param rightChildIn Right subtree.
+     */
+    PersistentTreeNode(const T & dataIn, Pointer leftChildIn, Pointer rightChildIn)
+            : data(dataIn), leftChild(std::move(leftChildIn)), rightChild(std::move(rightChildIn)),
+              height(1 + (heightOf(leftChild) > heightOf(rightChild) ? heightOf(leftChild) : heightOf(rightChild))),
+              size(1 + sizeOf(leftChild) + sizeOf(rightChild)) {
+    }
+
+    /**
+     * Get the height of a subtree.
+     * @param node Root of the subtree, may be nullptr.
+     * @return height, 0 for an empty subtree.
+     */
+    static int heightOf(const Pointer & node) {
+        return node ? node->height : 0;
+    }
+
+    /**
+     * Get the number of PersistentTreeNodes in a subtree.
+     * @param node Root of the subtree, may be nullptr.
+     * @return size, 0 for an empty subtree.
+     */
+    static size_t sizeOf(const Pointer & node) {
+        return node ? node->size : 0;
+    }
+
+};
+
+// ====================================================================================================================
+
+/**
+ * PersistentBinarySearchTree is an immutable AVL tree. Inserting or erasing gives a new version of the tree that
+ * shares every untouched PersistentTreeNode with the old one, only the O(log n) TreeNodes on the path are copied.
+ * Taking a snapshot is copying the tree object, which is O(1), and old versions stay valid for as long as someone
+ * holds them. Different threads may read and modify (into new versions) different copies of the same version at once.
+ * @tparam T Data type stored in the tree, copied into every new PersistentTreeNode on a changed path.
+ *
+ * @author Vakaris Paulavičius (K20062023)
+ * @version 1.0
+ */
+template<typename T>
+class PersistentBinarySearchTree {
+
+private:
+
+    typedef PersistentTreeNode<T> Node;
+    typedef typename Node::Pointer NodePointer;
+
+    NodePointer root;
+
+    // === METHODS ===
+
+    /**
+     * Constructor of a version with the provided root.
+     * @param rootIn Root of the version.
+     */
+    explicit PersistentBinarySearchTree(NodePointer rootIn)
+            : root(std::move(rootIn)) {
+    }
+
+    /**
+     * Make a new PersistentTreeNode.
+     */
+    static NodePointer makeNode(const T & data, NodePointer leftChild, NodePointer rightChild) {
+        return std::make_shared<const Node>(data, std::move(leftChild), std::move(rightChild));
+    }
+
+    /**
+     * Make a new subtree with the data at the root and the provided subtrees, whose heights differ by at most 2,
+     * rotating it if needed so that it is balanced.
+     * @param data Data of the root.
+     * @param leftChild Left subtree.
+     * @param rightChild Right subtree.
+     * @return root of the new subtree.
+     */
+    static NodePointer balance(const T & data, NodePointer leftChild, NodePointer rightChild) {
+        int leftSubtreeHeight = Node::heightOf(leftChild);
+        int rightSubtreeHeight = Node::heightOf(rightChild);
+        if(leftSubtreeHeight > rightSubtreeHeight + 1) {
+            if(Node::heightOf(leftChild->leftChild) >= Node::heightOf(leftChild->rightChild)) {
+                return makeNode(leftChild->data, leftChild->leftChild,
+                                makeNode(data, leftChild->rightChild, std::move(rightChild)));
+            }
+            const NodePointer & middle = leftChild->rightChild;
+            return makeNode(middle->data, makeNode(leftChild->data, leftChild->leftChild, middle->leftChild),
+                            makeNode(data, middle->rightChild, std::move(rightChild)));
+        }
+        if(rightSubtreeHeight > leftSubtreeHeight + 1) {
+            if(Node::heightOf(rightChild->rightChild) >= Node::heightOf(rightChild->leftChild)) {
+                return makeNode(rightChild->data, makeNode(data, std::move(leftChild), rightChild->leftChild),
+                                rightChild->rightChild);
+            }
+            const NodePointer & middle = rightChild->leftChild;
+            return makeNode(middle->data, makeNode(data, std::move(leftChild), middle->leftChild),
+                            makeNode(rightChild->data, middle->rightChild, rightChild->rightChild));
+        }
+        return makeNode(data, std::move(leftChild), std::move(rightChild));
+    }
+
+    /**
+     * Insert the data into a subtree.
+     * @param node Root of the subtree.
+     * @param data Data to insert.
+     * @return root of the new subtree, the same one if the data was already there.
+     */
+    static NodePointer insertInto(const NodePointer & node, const T & data) {
+        if(!node) {
+            return makeNode(data, nullptr, nullptr);
+        }
+        if(data < node->data) {
+            NodePointer newChild = insertInto(node->leftChild, data);
+            if(newChild == node->leftChild) {
+                return node;
+            }
+            return balance(node->data, std::move(newChild), node->rightChild);
+        }
+        if(node->data < data) {
+            NodePointer newChild = insertInto(node->rightChild, data);
+            if(newChild == node->rightChild) {
+                return node;
+            }
+            return balance(node->data, node->leftChild, std::move(newChild));
+        }
+        return node;
+    }
+
+    /**
+     * Remove the smallest element from a subtree.
+     * @param node Root of the subtree, not nullptr.
+     * @param smallest Set to the PersistentTreeNode holding the smallest element.
+     * @return root of the new subtree.
+     */
+    static NodePointer removeSmallest(const NodePointer & node, const Node * & smallest) {
+        if(!node->leftChild) {
+            smallest = node.get();
+            return node->rightChild;
+        }
+        NodePointer newChild = removeSmallest(node->leftChild, smallest);
+        return balance(node->data, std::move(newChild), node->rightChild);
+    }
+
+    /**
+     * Remove the data from a subtree.
+     * @param node Root of the subtree.
+     * @param data Data to remove.
+     * @return root of the new subtree, the same one if the data was not there.
+     */
+    static NodePointer eraseFrom(const NodePointer & node, const T & data) {
+        if(!node) {
+            return nullptr;
+        }
+        if(data < node->data) {
+            NodePointer newChild = eraseFrom(node->leftChild, data);
+            if(newChild == node->leftChild) {
+                return node;
+            }
+            return balance(node->data, std::move(newChild), node->rightChild);
+        }
+        if(node->data < data) {
+            NodePointer newChild = eraseFrom(node->rightChild, data);
+            if(newChild == node->rightChild) {
+                return node;
+            }
+            return balance(node->data, node->leftChild, std::move(newChild));
+        }
+        if(!node->leftChild) {
+            return node->rightChild;
+        }
+        if(!node->rightChild) {
+            return node->leftChild;
+        }
+        const Node * smallest = nullptr;
+        NodePointer newRightChild = removeSmallest(node->rightChild, smallest);
+        return balance(smallest->data, node->leftChild, std::move(newRightChild));
+    }
+
+public:
+
+    /**
+     * Default constructor of the PersistentBinarySearchTree with no elements inside.
+     */
+    PersistentBinarySearchTree() = default;
+
+    /**
+     * Get a snapshot of this version in O(1). It is the same as copying the tree.
+     * @return the snapshot.
+     */
+    PersistentBinarySearchTree snapshot() const{
+        return *this;
+    }
+
+    /**
+     * Get a new version of the tree with the element inserted, in O(log n). This version does not change.
+     * @param data Data element which to insert.
+     * @return the new version, sharing all TreeNodes off the path to the element with this one.
+     */
+    PersistentBinarySearchTree insert(const T & data) const{
+        return PersistentBinarySearchTree(insertInto(root, data));
+    }
+
+    /**
+     * Get a new version of the tree with the element removed, in O(log n). This version does not change.
+     * @param data Data element which to remove.
+     * @return the new version, sharing all TreeNodes off the path to the element with this one.
+     */
+    PersistentBinarySearchTree erase(const T & data) const{
+        return PersistentBinarySearchTree(eraseFrom(root, data));
+    }
+
+    /**
+     * Look for the element in the tree.
+     * @param data Data element, or anything that can be compared with T using operator<.
+     * @return pointer to the element, valid as long as a version holding it exists, nullptr if it is not there.
+     */
+    template<typename K>
+    const T * find(const K & data) const{
+        const Node * node = root.get();
+        while(node) {
+            if(data < node->data) {
+                node = node->leftChild.get();
+            }
+            else if(node->data < data) {
+                node = node->rightChild.get();
+            }
+            else {
+                return &node->data;
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * Get the number of elements in O(1).
+     * @return number of elements.
+     */
+    size_t size() const{
+        return Node::sizeOf(root);
+    }
+
+    /**
+     * Get the max depth of the tree in O(1).
+     * @return max depth.
+     */
+    int maxDepth() const{
+        return Node::heightOf(root);
+    }
+
+    /**
+     * Call the function on every element in order.
+     * @param fn Function taking a const reference to an element.
+     */
+    template<typename Fn>
+    void forEach(Fn fn) const{
+        forEachInOrder(root.get(), [&](const Node * node) { fn(node->data); });
+    }
+
+    /**
+     * Get the tree representation.
+     * @param o ostream object.
+     */
+    void write(ostream & o) const{
+        forEach([&](const T & data) { o << " " << data << " "; });
+    }
+
+    /**
+     * Check whether two versions are the same one, without looking at the elements.
+     * @param other Version to compare to.
+     * @return true if both versions share the root.
+     */
+    bool sharesRootWith(const PersistentBinarySearchTree & other) const{
+        return root == other.root;
+    }
+
+};
+
+#endif
@@ -2,140 +2,761 @@
 #define TREE_H
 
 #include "treenode.h"
+#include "nodearena.h"
+#include "bufferedsink.h"
+#include "frozentree.h"
+#include "treecompare.h"
+
+#include <algorithm>
+#include <future>
+#include <iterator>
+#include <type_traits>
+#include <vector>
 
 // TODO your code goes here:
 /**
  * BinarySearchTree is a class that implements a BinarySearchTree data structure and functionality..
  * @tparam T Data type stored in the current TreeNode.
+ * @tparam Allocator Allocator used for the TreeNodes (rebound to TreeNode<T>), e.g. ArenaAllocator<T>.
+ * @tparam Compare Ordering of the elements, TreeLess (operator<) by default. Searches compare once per level through
+ * ThreeWayCompare, so a Compare with a compare(a, b) member returning an int is used in its three-way form.
  *
  * @author Vakaris Paulavičius (K20062023)
- * @version 1.1
+ * @version 1.3
  */
-template<typename T>
+template<typename Key, typename Value, typename Allocator, typename Compare>
+class TreeMap;
+
+template<typename T, typename Allocator = std::allocator<T>, typename Compare = TreeLess>
 class BinarySearchTree {
 
+    template<typename Key, typename Value, typename MapAllocator, typename MapCompare>
+    friend class TreeMap;
+
 private:
 
-    unique_ptr<TreeNode<T>> root;
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<TreeNode<T> > NodeAllocator;
+    typedef std::allocator_traits<NodeAllocator> NodeAllocatorTraits;
+
+    // What combineSubtrees computes, the elements of a in each case winning over the equal ones of b
+    enum class SetOperation { Union, Intersection, Difference };
+
+    // Subtrees with fewer elements than this are never handed to another thread, it would cost more than it saves
+    static const size_t parallelGrain = 1 << 14;
+
+    NodeAllocator allocator;
+    Compare comparator;
+    // The TreeNodes are created through the allocator, so the unique_ptrs must never delete them: every TreeNode is
+    // released from its parent before destroyNode is called on it, and TreeNodeDeleter asserts that this holds
+    typename TreeNode<T>::ChildPointer root;
 
     // === METHODS ===
 
     /**
-     * Insert data into the BST recursively from the given TreeNode.
-     * @param node A TreeNode which to look for a place to insert from.
-     * @param data Data element to insert.
-     * @return Pointer to the TreeNode containing the specified data or nullptr if the data already exists in the tree.
+     * Check whether a comes before b in the ordering of the tree.
+     * @param a Data element, or anything that can be compared with T.
+     * @param b Data element, or anything that can be compared with T.
+     * @return true if a is smaller than b.
+     */
+    template<typename A, typename B>
+    bool isLess(const A & a, const B & b) const{
+        return comparator(a, b);
+    }
+
+    /**
+     * Compare a with b in the ordering of the tree, with a single comparison where the ordering allows it.
+     * @param a Data element, or anything that can be compared with T.
+     * @param b Data element, or anything that can be compared with T.
+     * @return a negative number if a is smaller than b, 0 if they are equal and a positive number if a is greater.
+     */
+    template<typename A, typename B>
+    int threeWay(const A & a, const B & b) const{
+        return ThreeWayCompare<Compare>::compare(comparator, a, b);
+    }
+
+    /**
+     * Allocate and construct a TreeNode through the allocator.
+     * @param args Arguments to pass to the TreeNode constructor.
+     * @return Pointer to the new TreeNode.
+     */
+    template<typename... Args>
+    TreeNode<T> * createNode(Args && ... args) {
+        TreeNode<T> * node = NodeAllocatorTraits::allocate(allocator, 1);
+        try {
+            NodeAllocatorTraits::construct(allocator, node, std::forward<Args>(args)...);
+        }
+        catch(...) {
+            NodeAllocatorTraits::deallocate(allocator, node, 1);
+            throw;
+        }
+        node->fromAllocator = true;
+        return node;
+    }
+
+    /**
+     * Destroy a TreeNode and give its memory back to the allocator.
+     * @param node A TreeNode whose children have already been released.
      */
-    TreeNode<T> * insertRecursively(TreeNode<T> * node, const T data) {
-        if(data < node->data) {
-            TreeNode<T> * pointer;
+    void destroyNode(TreeNode<T> * node) {
+        NodeAllocatorTraits::destroy(allocator, node);
+        NodeAllocatorTraits::deallocate(allocator, node, 1);
+    }
+
+    /**
+     * Destroy every TreeNode of a detached subtree. Walks down to a leaf, frees it and climbs back up to its parent,
+     * so it needs no recursion and no extra memory.
+     * @param node Root of the subtree, can be nullptr.
+     */
+    void destroySubtree(TreeNode<T> * node) {
+        while(node) {
             if(node->leftChild) {
-                pointer = insertRecursively(node->leftChild.get(), data);
+                node = node->leftChild.release();
+            }
+            else if(node->rightChild) {
+                node = node->rightChild.release();
             }
             else {
-                node->setLeftChild(new TreeNode<T>(data));
-                pointer = node->leftChild.get();
+                TreeNode<T> * nodesParent = node->parent;
+                destroyNode(node);
+                node = nodesParent;
             }
-            return pointer;
         }
-        else if(node->data < data) {
-            TreeNode<T> * pointer;
-            if(node->rightChild) {
-                pointer = insertRecursively(node->rightChild.get(), data);
-            }
-            else {
-                node->setRightChild(new TreeNode<T>(data));
-                pointer = node->rightChild.get();
+    }
+
+    /**
+     * Walk down from the root looking for the place of the provided key.
+     * One comparison per level, the child to go to being picked without a branch.
+     * @param key Data element, or anything that can be compared with T.
+     * @param parent Set to the TreeNode under which the key belongs, nullptr if the tree is empty.
+     * @param left Set to true if the key belongs to the left of parent.
+     * @return Pointer to the TreeNode holding data equal to the key, nullptr if there is none.
+     */
+    template<typename K>
+    TreeNode<T> * findInsertPosition(const K & key, TreeNode<T> * & parent, bool & left) const{
+        parent = nullptr;
+        left = false;
+        TreeNode<T> * node = root.get();
+        while(node) {
+            int order = threeWay(key, node->data);
+            if(order == 0) {
+                return node;
             }
-            return pointer;
+            parent = node;
+            left = order < 0;
+            node = (left ? node->leftChild : node->rightChild).get();
+        }
+        return nullptr;
+    }
+
+    /**
+     * Link a new TreeNode at the place found by findInsertPosition and rebalance the BST.
+     * @param node The new TreeNode.
+     * @param parent TreeNode under which to link it, nullptr to make it the root.
+     * @param left true to make it the left child of parent.
+     * @return The new TreeNode.
+     */
+    TreeNode<T> * attachNode(TreeNode<T> * node, TreeNode<T> * parent, bool left) {
+        if(!parent) {
+            root.reset(node);
+            return node;
+        }
+        if(left) {
+            parent->setLeftChild(node);
         }
         else {
+            parent->setRightChild(node);
+        }
+        updateSizesUpwards(parent);
+        retraceInsertion(parent);
+        return node;
+    }
+
+    /**
+     * Insert data into the BST by walking down from the root in a loop.
+     * The data is only copied or moved once, into the newly allocated TreeNode.
+     * @tparam U Either const T & or T, so that the data can be forwarded into the TreeNode.
+     * @param data Data element to insert.
+     * @return Pointer to the TreeNode containing the specified data or nullptr if the data already exists in the tree.
+     */
+    template<typename U>
+    TreeNode<T> * insertIteratively(U && data) {
+        TreeNode<T> * parent;
+        bool left;
+        if(findInsertPosition(data, parent, left)) {
             return nullptr; // Already exists
         }
+        return attachNode(createNode(std::forward<U>(data)), parent, left);
     }
 
     /**
-     * Look for data in the BST recursively from the given TreeNode.
-     * @param node A TreeNode which to look for data from.
-     * @param data Data element which to look for.
-     * @return Pointer to the TreeNode containing the specified data or nullptr if the data is not in the tree.
+     * Make this (empty) BST a copy of the subtree rooted at the provided TreeNode, with the same shape and cached
+     * heights and sizes. Walks both trees side by side using the parent pointers, so it needs no recursion and no stack.
+     * The copies are created in preorder, so with an ArenaAllocator they end up next to each other in memory.
+     * @param source Root of the subtree which to copy, can be nullptr.
      */
-    TreeNode<T> * findRecursively(TreeNode<T> * node, const T data) const{
-        if(node) {
-            if(data == node->data) {
-                return node;
+    void copyFrom(TreeNode<T> * source) {
+        if(!source) {
+            return;
+        }
+        TreeNode<T> * sourceRoot = source;
+        TreeNode<T> * copy = createNode(source->data);
+        copy->height = source->height;
+        copy->size = source->size;
+        root.reset(copy);
+        while(true) {
+            if(source->leftChild && !copy->leftChild) {
+                source = source->leftChild.get();
+                copy->setLeftChild(createNode(source->data));
+                copy = copy->leftChild.get();
             }
-            else if(data < node->data){
-                TreeNode<T> * pointer = nullptr;
-                if(node->leftChild) {
-                    pointer = findRecursively(node->leftChild.get(), data);
-                }
-                return pointer;
+            else if(source->rightChild && !copy->rightChild) {
+                source = source->rightChild.get();
+                copy->setRightChild(createNode(source->data));
+                copy = copy->rightChild.get();
             }
-            else { // if(node->data < data)
-                TreeNode<T> * pointer = nullptr;
-                if(node->rightChild) {
-                    pointer = findRecursively(node->rightChild.get(), data);
-                }
-                return pointer;
+            else if(source == sourceRoot) {
+                return;
             }
+            else {
+                source = source->parent;
+                copy = copy->parent;
+                continue;
+            }
+            copy->height = source->height;
+            copy->size = source->size;
         }
-        else {
+    }
+
+    /**
+     * Build a height-balanced subtree out of the next count elements of a sorted sequence, in order, so that every
+     * element is read exactly once. The middle element becomes the root, which makes the sizes of the two subtrees
+     * differ by at most one and therefore their heights too. If creating a TreeNode throws, the TreeNodes created
+     * so far are destroyed before the exception is passed on.
+     * @param position Iterator to the first element to use, advanced past the last one used.
+     * @param count Number of elements to put in the subtree.
+     * @return Root of the subtree, nullptr if count is 0.
+     */
+    template<typename Iterator>
+    TreeNode<T> * buildSorted(Iterator & position, size_t count) {
+        if(count == 0) {
             return nullptr;
         }
+        size_t leftCount = (count - 1) / 2;
+        TreeNode<T> * node = buildSorted(position, leftCount);
+        try {
+            TreeNode<T> * leftSubtree = node;
+            node = createNode(*position);
+            node->setLeftChild(leftSubtree);
+            ++position;
+            node->setRightChild(buildSorted(position, count - leftCount - 1));
+        }
+        catch(...) {
+            destroySubtree(node);
+            throw;
+        }
+        node->updateHeight();
+        node->updateSize();
+        return node;
     }
 
     /**
-     * Make copies of the oldNode children and make those copies as newNode children.
-     * @param newNode A TreeNode which to update.
-     * @param oldNode A TreeNode whose children to copy.
+     * Link an array of detached TreeNodes, sorted by their data, into a height-balanced subtree, the same way
+     * buildSorted does, without creating or comparing anything.
+     * @param nodes First TreeNode to use.
+     * @param count Number of TreeNodes to put in the subtree.
+     * @return Root of the subtree, nullptr if count is 0.
      */
-    void copyRecursively(TreeNode<T> * newNode, TreeNode<T> * oldNode) {
-        if(oldNode->leftChild) {
-            newNode->setLeftChild(new TreeNode<T>(oldNode->leftChild->data), newNode);
-            copyRecursively(newNode->leftChild.get(), oldNode->leftChild.get());
+    static TreeNode<T> * linkSorted(TreeNode<T> * const * nodes, size_t count) {
+        if(count == 0) {
+            return nullptr;
         }
+        size_t leftCount = (count - 1) / 2;
+        TreeNode<T> * node = nodes[leftCount];
+        node->setLeftChild(linkSorted(nodes, leftCount));
+        node->setRightChild(linkSorted(nodes + leftCount + 1, count - leftCount - 1));
+        node->updateHeight();
+        node->updateSize();
+        return node;
+    }
+
+    /**
+     * Get every TreeNode of a subtree in order, leaving the subtree as it is.
+     * @param subtree Root of the subtree, can be nullptr.
+     * @return the TreeNodes.
+     */
+    static std::vector<TreeNode<T> *> collectNodes(TreeNode<T> * subtree) {
+        std::vector<TreeNode<T> *> nodes;
+        nodes.reserve(subtree ? subtree->size : 0);
+        forEachInOrder(subtree, [&](TreeNode<T> * node) { nodes.push_back(node); });
+        return nodes;
+    }
 
-        if(oldNode->rightChild) {
-            newNode->setRightChild(new TreeNode<T>(oldNode->rightChild->data), newNode);
-            copyRecursively(newNode->rightChild.get(), oldNode->rightChild.get());
+    /**
+     * Sort the elements and remove the duplicates, unless they already are sorted with no duplicates.
+     * @param elements The elements.
+     * @param comp Ordering of the elements.
+     */
+    static void sortUnique(std::vector<T> & elements, const Compare & comp) {
+        if(!isStrictlySorted(elements.begin(), elements.end(), comp)) {
+            std::sort(elements.begin(), elements.end(), comp);
+            elements.erase(std::unique(elements.begin(), elements.end(),
+                                       [&](const T & a, const T & b) { return !comp(a, b); }),
+                           elements.end());
         }
     }
 
     // ===================== AVL tree functionality =====================
 
     /**
-     * Check if the BST became unbalanced after the most recent insertion.
-     * @param node Inserted TreeNode.
+     * Recalculate the cached sizes of the provided TreeNode and all of its ancestors. Unlike the heights, every
+     * size on the path to the root changes when an element is added or removed, so this always goes all the way up.
+     * @param node A TreeNode which to start from.
      */
-    void checkBalance(TreeNode<T> * node) {
-        TreeNode<T> * parentParent = node->parent->parent;
-        if(parentParent) {
-            int balanceFactor = parentParent->balanceFactor();
+    void updateSizesUpwards(TreeNode<T> * node) {
+        while(node) {
+            node->updateSize();
+            node = node->parent;
+        }
+    }
+
+    /**
+     * Walk from the parent of the most recently inserted TreeNode up to the root, refreshing the cached heights and
+     * rebalancing the first TreeNode that became unbalanced. Stops as soon as a height does not change, because
+     * nothing above it can be affected.
+     * @param node Parent of the inserted TreeNode.
+     */
+    void retraceInsertion(TreeNode<T> * node) {
+        while(node) {
+            int oldHeight = node->height;
+            node->updateHeight();
+            int balanceFactor = node->balanceFactor();
             if(balanceFactor == 2 || balanceFactor == -2) {
-                balance(node, parentParent);
+                // A rotation after an insertion restores the height the subtree had before it, so we are done
+                balance(node);
+                return;
+            }
+            if(node->height == oldHeight) {
+                return;
             }
+            node = node->parent;
         }
     }
 
     /**
-     * Balance the unbalanced BST by performing the right rotation.
-     * @param node Inserted TreeNode.
-     * @param parentParent Parent of the parent of the inserted TreeNode.
+     * Walk from the parent of the most recently removed TreeNode up to the root, refreshing the cached heights and
+     * rebalancing every TreeNode that became unbalanced. Unlike an insertion, a rotation after a removal can shorten
+     * the subtree, so the walk only stops once a subtree keeps its old height.
+     * @param node Lowest TreeNode whose subtree lost an element.
      */
-    void balance(TreeNode<T> * node, TreeNode<T> * parentParent) {
-        if(parentParent->rightChild && parentParent->rightChild->rightChild.get() == node) {
-            leftLeftRotation(parentParent);
+    void retraceErasure(TreeNode<T> * node) {
+        while(node) {
+            int oldHeight = node->height;
+            node->updateHeight();
+            int balanceFactor = node->balanceFactor();
+            if(balanceFactor == 2 || balanceFactor == -2) {
+                node = balance(node);
+            }
+            if(node->height == oldHeight) {
+                return;
+            }
+            node = node->parent;
         }
-        else if(parentParent->leftChild && parentParent->leftChild->leftChild.get() == node) {
-            rightRightRotation(parentParent);
+    }
+
+    /**
+     * Put the replacement TreeNode in the place of the provided TreeNode, without freeing either of them.
+     * @param node A TreeNode which to take out of its parent (or out of the root).
+     * @param replacement A TreeNode which to put in its place, can be nullptr.
+     */
+    void replaceInParent(TreeNode<T> * node, TreeNode<T> * replacement) {
+        TreeNode<T> * nodesParent = node->parent;
+        if(nodesParent) {
+            if(nodesParent->leftChild.get() == node) {
+                nodesParent->leftChild.release();
+                nodesParent->setLeftChild(replacement);
+            }
+            else {
+                nodesParent->rightChild.release();
+                nodesParent->setRightChild(replacement);
+            }
         }
-        else if(parentParent->leftChild && parentParent->leftChild->rightChild.get() == node) {
-            leftRightRotation(parentParent);
+        else {
+            root.release();
+            root.reset(replacement);
+            if(replacement) {
+                replacement->parent = nullptr;
+            }
         }
-        else if(parentParent->rightChild && parentParent->rightChild->leftChild.get() == node) {
-            rightLeftRotation(parentParent);
+        node->parent = nullptr;
+    }
+
+    /**
+     * Unlink the provided TreeNode from the BST, rebalance it and free the TreeNode.
+     * @param node A TreeNode of this BST which to remove.
+     * @return The TreeNode that followed the removed one in order, nullptr if it was the last one.
+     */
+    TreeNode<T> * eraseNode(TreeNode<T> * node) {
+        TreeNode<T> * next = unlinkNode(node);
+        destroyNode(node);
+        return next;
+    }
+
+    /**
+     * Take the provided TreeNode out of the BST and rebalance it, without freeing the TreeNode.
+     * A TreeNode with two children is replaced by its in-order successor, which is moved rather than copied, so
+     * pointers to every other TreeNode stay valid.
+     * @param node A TreeNode of this BST which to take out, left with no parent and no children.
+     * @return The TreeNode that followed the removed one in order, nullptr if it was the last one.
+     */
+    TreeNode<T> * unlinkNode(TreeNode<T> * node) {
+        TreeNode<T> * next;
+        TreeNode<T> * retraceFrom;
+        if(node->leftChild && node->rightChild) {
+            next = node->rightChild->findLeftmostChild();
+            // Take the successor out of its place first, its right subtree (if any) moves up to replace it
+            TreeNode<T> * nextsParent = next->parent;
+            TreeNode<T> * rightChildOfNext = next->rightChild.release();
+            if(nextsParent == node) {
+                node->rightChild.release();
+                node->setRightChild(rightChildOfNext);
+                retraceFrom = next;
+            }
+            else {
+                nextsParent->leftChild.release();
+                nextsParent->setLeftChild(rightChildOfNext);
+                retraceFrom = nextsParent;
+            }
+            // Then let it take over the children and the position of the removed TreeNode
+            next->setLeftChild(node->leftChild.release());
+            next->setRightChild(node->rightChild.release());
+            next->height = node->height;
+            replaceInParent(node, next);
+        }
+        else {
+            next = node->rightChild ? node->rightChild->findLeftmostChild() : node->findNextTreeNodeWhenRightChildIsNull();
+            TreeNode<T> * onlyChild = node->leftChild ? node->leftChild.release() : node->rightChild.release();
+            retraceFrom = node->parent;
+            replaceInParent(node, onlyChild);
         }
+        updateSizesUpwards(retraceFrom);
+        retraceErasure(retraceFrom);
+        return next;
+    }
+
+    /**
+     * Join two detached subtrees and a TreeNode that goes between them into one AVL subtree, in
+     * O(|height(left) - height(right)| + 1). The middle TreeNode is hung on the spine of the taller subtree where
+     * the heights match, and the path above it is retraced like after an erasure, because a rotation may or may not
+     * restore the height there. The root of the BST is used as scratch space for the rotations, so it must be empty.
+     * @param left Root of the subtree with the smaller elements, can be nullptr.
+     * @param middle Detached TreeNode greater than every element of left and smaller than every element of right.
+     * @param right Root of the subtree with the greater elements, can be nullptr.
+     * @return Root of the joined subtree, detached.
+     */
+    TreeNode<T> * joinSubtrees(TreeNode<T> * left, TreeNode<T> * middle, TreeNode<T> * right) {
+        int leftHeight = left ? left->height : 0;
+        int rightHeight = right ? right->height : 0;
+        if(leftHeight <= rightHeight + 1 && rightHeight <= leftHeight + 1) {
+            middle->setLeftChild(left);
+            middle->setRightChild(right);
+            middle->parent = nullptr;
+            middle->updateHeight();
+            middle->updateSize();
+            return middle;
+        }
+        // Heights drop by one or two along a spine, so the spine may end in an empty subtree of the right height
+        TreeNode<T> * spinesParent = nullptr;
+        TreeNode<T> * spine;
+        if(leftHeight > rightHeight) {
+            root.reset(left);
+            spine = left;
+            while(spine && spine->height > rightHeight + 1) {
+                spinesParent = spine;
+                spine = spine->rightChild.get();
+            }
+            spinesParent->rightChild.release();
+            middle->setLeftChild(spine);
+            middle->setRightChild(right);
+            spinesParent->setRightChild(middle);
+        }
+        else {
+            root.reset(right);
+            spine = right;
+            while(spine && spine->height > leftHeight + 1) {
+                spinesParent = spine;
+                spine = spine->leftChild.get();
+            }
+            spinesParent->leftChild.release();
+            middle->setLeftChild(left);
+            middle->setRightChild(spine);
+            spinesParent->setLeftChild(middle);
+        }
+        middle->updateHeight();
+        updateSizesUpwards(middle);
+        retraceErasure(middle->parent);
+        return root.release();
+    }
+
+    /**
+     * Split a detached subtree into the elements smaller than the key and the rest, in O(log n), by taking the
+     * subtree apart along the search path of the key and joining the pieces on each side back together.
+     * The root of the BST is used as scratch space for the joins, so it must be empty.
+     * @param node Root of the subtree, can be nullptr.
+     * @param key Anything that can be compared with T.
+     * @param smaller Set to the detached root of the elements smaller than the key.
+     * @param notSmaller Set to the detached root of the other elements.
+     */
+    template<typename K>
+    void splitSubtree(TreeNode<T> * node, const K & key, TreeNode<T> * & smaller, TreeNode<T> * & notSmaller) {
+        if(!node) {
+            smaller = nullptr;
+            notSmaller = nullptr;
+            return;
+        }
+        TreeNode<T> * leftSubtree = node->leftChild.release();
+        TreeNode<T> * rightSubtree = node->rightChild.release();
+        if(leftSubtree) {
+            leftSubtree->parent = nullptr;
+        }
+        if(rightSubtree) {
+            rightSubtree->parent = nullptr;
+        }
+        if(isLess(node->data, key)) {
+            TreeNode<T> * rightSmaller;
+            splitSubtree(rightSubtree, key, rightSmaller, notSmaller);
+            smaller = joinSubtrees(leftSubtree, node, rightSmaller);
+        }
+        else {
+            TreeNode<T> * leftNotSmaller;
+            splitSubtree(leftSubtree, key, smaller, leftNotSmaller);
+            notSmaller = joinSubtrees(leftNotSmaller, node, rightSubtree);
+        }
+    }
+
+    /**
+     * Split a detached subtree around an element like splitSubtree, but take a TreeNode equal to it out on its own.
+     * @param node Root of the subtree, can be nullptr.
+     * @param data Element at which to split.
+     * @param smaller Set to the detached root of the elements smaller than data.
+     * @param greater Set to the detached root of the elements greater than data.
+     * @return The detached TreeNode equal to data, nullptr if there is none.
+     */
+    TreeNode<T> * splitAround(TreeNode<T> * node, const T & data, TreeNode<T> * & smaller, TreeNode<T> * & greater) {
+        if(!node) {
+            smaller = nullptr;
+            greater = nullptr;
+            return nullptr;
+        }
+        TreeNode<T> * leftSubtree = detachChild(node->leftChild);
+        TreeNode<T> * rightSubtree = detachChild(node->rightChild);
+        TreeNode<T> * equal;
+        int order = threeWay(node->data, data);
+        if(order < 0) {
+            TreeNode<T> * rightSmaller;
+            equal = splitAround(rightSubtree, data, rightSmaller, greater);
+            smaller = joinSubtrees(leftSubtree, node, rightSmaller);
+        }
+        else if(order > 0) {
+            TreeNode<T> * leftGreater;
+            equal = splitAround(leftSubtree, data, smaller, leftGreater);
+            greater = joinSubtrees(leftGreater, node, rightSubtree);
+        }
+        else {
+            smaller = leftSubtree;
+            greater = rightSubtree;
+            equal = node;
+        }
+        return equal;
+    }
+
+    /**
+     * Release a child of a TreeNode and cut it off from its parent.
+     * @param child The leftChild or rightChild of a TreeNode.
+     * @return The detached child, can be nullptr.
+     */
+    static TreeNode<T> * detachChild(typename TreeNode<T>::ChildPointer & child) {
+        TreeNode<T> * detached = child.release();
+        if(detached) {
+            detached->parent = nullptr;
+        }
+        return detached;
+    }
+
+    /**
+     * Join two detached subtrees, all elements of left being smaller than all elements of right, by taking the
+     * smallest TreeNode out of right and putting it between them. The root of the BST must be empty.
+     * @param left Root of the subtree with the smaller elements, can be nullptr.
+     * @param right Root of the subtree with the greater elements, can be nullptr.
+     * @return Root of the joined subtree, detached.
+     */
+    TreeNode<T> * joinSubtrees(TreeNode<T> * left, TreeNode<T> * right) {
+        if(!left) {
+            return right;
+        }
+        if(!right) {
+            return left;
+        }
+        root.reset(right);
+        TreeNode<T> * middle = right->findLeftmostChild();
+        unlinkNode(middle);
+        return joinSubtrees(left, middle, root.release());
+    }
+
+    /**
+     * Combine two detached subtrees the way the set operation asks for, by splitting b around the root of a, combining
+     * the two pairs of halves and joining the results, in O(m log(n / m + 1)) work for subtrees of n and m elements.
+     * Each recursion level hands one pair of halves to another thread as long as threads are left, every thread
+     * using its own scratch BinarySearchTree for the rotations. No TreeNode is created, and the ones left over are
+     * only collected, so that the caller can free them on its own thread.
+     * @param operation Which set operation to perform.
+     * @param a Root of the first subtree, whose elements win over equal ones of b, can be nullptr.
+     * @param b Root of the second subtree, can be nullptr.
+     * @param threads Number of threads the operation may use, at least 1.
+     * @param discarded Roots of the detached subtrees that are not part of the result are added to it.
+     * @return Root of the combined subtree, detached.
+     */
+    TreeNode<T> * combineSubtrees(SetOperation operation, TreeNode<T> * a, TreeNode<T> * b, unsigned threads,
+                                  std::vector<TreeNode<T> *> & discarded) {
+        if(!a || !b) {
+            TreeNode<T> * other = a ? a : b;
+            if(operation == SetOperation::Union || (operation == SetOperation::Difference && other == a)) {
+                return other;
+            }
+            if(other) {
+                discarded.push_back(other);
+            }
+            return nullptr;
+        }
+        bool parallel = threads > 1 && a->size + b->size >= parallelGrain;
+        TreeNode<T> * leftA = detachChild(a->leftChild);
+        TreeNode<T> * rightA = detachChild(a->rightChild);
+        TreeNode<T> * leftB;
+        TreeNode<T> * rightB;
+        TreeNode<T> * equal = splitAround(b, a->data, leftB, rightB);
+
+        TreeNode<T> * left;
+        TreeNode<T> * right;
+        if(parallel) {
+            std::vector<TreeNode<T> *> leftDiscarded;
+            Allocator alloc(allocator);
+            unsigned leftThreads = threads / 2;
+            std::future<TreeNode<T> *> leftFuture = std::async(std::launch::async, [&]() {
+                BinarySearchTree scratch(alloc, comparator);
+                return scratch.combineSubtrees(operation, leftA, leftB, leftThreads, leftDiscarded);
+            });
+            right = combineSubtrees(operation, rightA, rightB, threads - leftThreads, discarded);
+            left = leftFuture.get();
+            discarded.insert(discarded.end(), leftDiscarded.begin(), leftDiscarded.end());
+        }
+        else {
+            left = combineSubtrees(operation, leftA, leftB, 1, discarded);
+            right = combineSubtrees(operation, rightA, rightB, 1, discarded);
+        }
+
+        if(equal) {
+            discarded.push_back(equal);
+        }
+        bool keepA = operation == SetOperation::Union || (operation == SetOperation::Intersection) == (equal != nullptr);
+        if(keepA) {
+            return joinSubtrees(left, a, right);
+        }
+        discarded.push_back(a);
+        return joinSubtrees(left, right);
+    }
+
+    /**
+     * Perform a set operation with the other BinarySearchTree, leaving the result in this one and the other one empty.
+     * TreeNodes of another allocator are first moved into new TreeNodes of this one.
+     * @param operation Which set operation to perform.
+     * @param other BinarySearchTree to combine with.
+     * @param threads Number of threads the operation may use.
+     */
+    void combineWith(SetOperation operation, BinarySearchTree && other, unsigned threads) {
+        if(!(allocator == other.allocator)) {
+            Allocator alloc(allocator);
+            BinarySearchTree converted(alloc, comparator);
+            converted.insertSortedBatch(std::make_move_iterator(other.begin()), std::make_move_iterator(other.end()));
+            other.clear();
+            combineWith(operation, std::move(converted), threads);
+            return;
+        }
+        std::vector<TreeNode<T> *> discarded;
+        TreeNode<T> * result = combineSubtrees(operation, root.release(), other.root.release(),
+                                               threads > 0 ? threads : 1, discarded);
+        for(TreeNode<T> * subtree : discarded) {
+            destroySubtree(subtree);
+        }
+        root.reset(result);
+    }
+
+    /**
+     * Build a height-balanced subtree like buildSorted, handing the left half to another thread at every level as
+     * long as threads are left. Each thread creates its TreeNodes through its own copy of the allocator. If creating a
+     * TreeNode throws on any thread, every TreeNode created so far is destroyed before the exception is passed on.
+     * @param first Random access iterator to the first element to use.
+     * @param count Number of elements to put in the subtree.
+     * @param threads Number of threads the build may use, at least 1.
+     * @return Root of the subtree, nullptr if count is 0.
+     */
+    template<typename Iterator>
+    TreeNode<T> * buildSortedInParallel(Iterator first, size_t count, unsigned threads) {
+        if(threads <= 1 || count < parallelGrain) {
+            return buildSorted(first, count);
+        }
+        size_t leftCount = (count - 1) / 2;
+        Allocator alloc(allocator);
+        unsigned leftThreads = threads / 2;
+        std::future<TreeNode<T> *> leftFuture = std::async(std::launch::async, [&]() {
+            BinarySearchTree scratch(alloc, comparator);
+            return scratch.buildSortedInParallel(first, leftCount, leftThreads);
+        });
+        TreeNode<T> * node = nullptr;
+        try {
+            node = createNode(first[leftCount]);
+            node->setRightChild(buildSortedInParallel(first + leftCount + 1, count - leftCount - 1,
+                                                      threads - leftThreads));
+            node->setLeftChild(leftFuture.get());
+        }
+        catch(...) {
+            destroySubtree(node);
+            if(leftFuture.valid()) {
+                // The left half is still being built, wait for it and free it too
+                try {
+                    destroySubtree(leftFuture.get());
+                }
+                catch(...) {
+                }
+            }
+            throw;
+        }
+        node->updateHeight();
+        node->updateSize();
+        return node;
+    }
+
+    /**
+     * Balance the unbalanced TreeNode by performing the rotation its balance factor requires.
+     * @param node A TreeNode whose balance factor is 2 or -2.
+     * @return The TreeNode that took the place of the provided one.
+     */
+    TreeNode<T> * balance(TreeNode<T> * node) {
+        if(node->balanceFactor() > 0) {
+            if(node->leftChild->balanceFactor() >= 0) {
+                rightRightRotation(node);
+            }
+            else {
+                leftRightRotation(node);
+            }
+        }
+        else {
+            if(node->rightChild->balanceFactor() <= 0) {
+                leftLeftRotation(node);
+            }
+            else {
+                rightLeftRotation(node);
+            }
+        }
+        return node->parent;
     }
 
     /**
@@ -148,7 +769,7 @@ private:
         TreeNode<T> * leftChildOfNodesRightChild = nodesRightChild->leftChild.release();
         if(nodesParent) { // Means that "node" is not the root of the tree
             TreeNode<T> * nodePointer;
-            if(node->data < nodesParent->data) {
+            if(nodesParent->leftChild.get() == node) {
                 nodePointer = nodesParent->leftChild.release();
                 nodesParent->setLeftChild(nodesRightChild);
             }
@@ -166,6 +787,10 @@ private:
             rootPointer->setRightChild(leftChildOfNodesRightChild);
             nodesRightChild->parent = nullptr;
         }
+        node->updateHeight();
+        node->updateSize();
+        nodesRightChild->updateHeight();
+        nodesRightChild->updateSize();
     }
 
     /**
@@ -178,7 +803,7 @@ private:
         TreeNode<T> * rightChildOfNodesLeftChild = nodesLeftChild->rightChild.release();
         if(nodesParent) { // Means that "node" is not the root of the tree
             TreeNode<T> * nodePointer;
-            if(node->data < nodesParent->data) {
+            if(nodesParent->leftChild.get() == node) {
                 nodePointer = nodesParent->leftChild.release();
                 nodesParent->setLeftChild(nodesLeftChild);
             }
@@ -196,6 +821,10 @@ private:
             rootPointer->setLeftChild(rightChildOfNodesLeftChild);
             nodesLeftChild->parent = nullptr;
         }
+        node->updateHeight();
+        node->updateSize();
+        nodesLeftChild->updateHeight();
+        nodesLeftChild->updateSize();
     }
 
     /**
@@ -216,22 +845,438 @@ private:
         leftLeftRotation(node);
     }
 
+    /**
+     * Find the TreeNode holding the first element that is not smaller than the key.
+     * @param key Data element, or anything that can be compared with T.
+     * @return the TreeNode, nullptr if every element is smaller than the key.
+     */
+    template<typename K>
+    TreeNode<T> * findLowerBound(const K & key) const{
+        TreeNode<T> * found = nullptr;
+        TreeNode<T> * node = root.get();
+        while(node) {
+            if(isLess(node->data, key)) {
+                node = node->rightChild.get();
+            }
+            else {
+                found = node;
+                node = node->leftChild.get();
+            }
+        }
+        return found;
+    }
+
+    /**
+     * Find the TreeNode holding the first element that is greater than the key.
+     * @param key Data element, or anything that can be compared with T.
+     * @return the TreeNode, nullptr if no element is greater than the key.
+     */
+    template<typename K>
+    TreeNode<T> * findUpperBound(const K & key) const{
+        TreeNode<T> * found = nullptr;
+        TreeNode<T> * node = root.get();
+        while(node) {
+            if(isLess(key, node->data)) {
+                found = node;
+                node = node->leftChild.get();
+            }
+            else {
+                node = node->rightChild.get();
+            }
+        }
+        return found;
+    }
+
+    /**
+     * Visit the elements of the subtree in order using an explicit stack, without following parent pointers.
+     * Only the subtrees that can hold elements in [lo, hi) are entered.
+     * @param node Root of the subtree.
+     * @param lo Smallest element to visit, nullptr for no lower bound.
+     * @param hi Smallest element not to visit, nullptr for no upper bound.
+     * @param fn Function to call with every visited element.
+     * @param comparator Ordering of the tree.
+     */
+    template<typename Node, typename K, typename Fn>
+    static void scanNodes(Node * node, const K * lo, const K * hi, Fn & fn, const Compare & comparator) {
+        InOrderStack<Node> stack;
+        for(;;) {
+            while(node) {
+                if(lo && comparator(node->data, *lo)) {
+                    node = node->rightChild.get();
+                }
+                else {
+                    stack.push(node);
+                    node = node->leftChild.get();
+                }
+            }
+            if(stack.empty()) {
+                return;
+            }
+            node = stack.pop();
+            if(hi && !comparator(node->data, *hi)) {
+                return;
+            }
+            fn(node->data);
+            node = node->rightChild.get();
+        }
+    }
+
+    /**
+     * Write the elements in [lo, hi) in order through a BufferedSink, with the separator between them.
+     * @param o ostream object.
+     * @param lo Smallest element to write, nullptr for no lower bound.
+     * @param hi Smallest element not to write, nullptr for no upper bound.
+     * @param separator Written between two elements.
+     * @param format Function taking the BufferedSink and an element that writes the element.
+     */
+    template<typename K, typename Formatter>
+    void writeElements(ostream & o, const K * lo, const K * hi, const std::string & separator,
+                       Formatter & format) const{
+        BufferedSink sink(o);
+        // The elements are collected a batch at a time and formatted afterwards: interleaving the formatting with
+        // the walk keeps the processor from fetching the next TreeNodes early, which makes writing several
+        // times slower
+        const size_t batchSize = 256;
+        const T * batch[batchSize];
+        size_t collected = 0;
+        bool first = true;
+        auto writeBatch = [&]() {
+            for(size_t i = 0; i < collected; ++i) {
+                if(!first) {
+                    sink.append(separator);
+                }
+                first = false;
+                format(sink, *batch[i]);
+            }
+            collected = 0;
+        };
+        auto collect = [&](const T & data) {
+            batch[collected++] = &data;
+            if(collected == batchSize) {
+                writeBatch();
+            }
+        };
+        scanNodes<const TreeNode<T>, K>(root.get(), lo, hi, collect, comparator);
+        writeBatch();
+    }
+
+    /**
+     * Relink the TreeNodes of a detached subtree together with new TreeNodes for the elements of a sorted batch with
+     * no duplicates into a perfectly balanced subtree, in O(k + m) for k TreeNodes and m elements. If creating a
+     * TreeNode throws, the subtree is left as it was.
+     * @param subtree Root of the detached subtree, can be nullptr.
+     * @param first Forward iterator to the first element.
+     * @param last Forward iterator past the last element.
+     * @param inserted Set to the number of elements that were not in the subtree yet.
+     * @return Root of the merged subtree, detached.
+     */
+    template<typename Iterator>
+    TreeNode<T> * mergeIntoSubtree(TreeNode<T> * subtree, Iterator first, Iterator last, size_t & inserted) {
+        typedef typename std::iterator_traits<Iterator>::reference Reference;
+        std::vector<TreeNode<T> *> existing = collectNodes(subtree);
+        std::vector<TreeNode<T> *> created;
+        try {
+            size_t position = 0;
+            for(; first != last; ++first) {
+                // compared as a named reference, so that a move iterator only moves the element into its TreeNode
+                Reference element = *first;
+                while(position < existing.size() && isLess(existing[position]->data, element)) {
+                    ++position;
+                }
+                if(position == existing.size() || isLess(element, existing[position]->data)) {
+                    created.push_back(nullptr);
+                    created.back() = createNode(std::forward<Reference>(element));
+                }
+            }
+        }
+        catch(...) {
+            for(TreeNode<T> * node : created) {
+                if(node) {
+                    destroyNode(node);
+                }
+            }
+            throw;
+        }
+
+        std::vector<TreeNode<T> *> merged(existing.size() + created.size());
+        std::merge(existing.begin(), existing.end(), created.begin(), created.end(), merged.begin(),
+                   [this](const TreeNode<T> * a, const TreeNode<T> * b) { return isLess(a->data, b->data); });
+        for(TreeNode<T> * node : existing) {
+            node->leftChild.release();
+            node->rightChild.release();
+        }
+        TreeNode<T> * mergedRoot = linkSorted(merged.data(), merged.size());
+        if(mergedRoot) {
+            mergedRoot->parent = nullptr;
+        }
+        inserted = created.size();
+        return mergedRoot;
+    }
+
+    /**
+     * Insert a batch of elements that is sorted with no duplicates, which is not checked: only insertBatch, join and
+     * TreeMap, which sort the elements or already hold them in order, call it.
+     * A batch of m elements that is small next to the k elements of the BST between its first and last element is
+     * inserted one by one in O(m log n). For a bigger one that range is split off in O(log n), merged with the batch
+     * by relinking its TreeNodes into a perfectly balanced subtree without copying them, in O(k + m), and joined back,
+     * so a batch that falls into a narrow key range does not touch the rest of the BST. If creating a TreeNode throws
+     * while merging, the BST is left as it was.
+     * @param first Forward iterator to the first element.
+     * @param last Forward iterator past the last element.
+     * @return number of elements inserted, elements that were already in the BST are left out.
+     */
+    template<typename Iterator>
+    size_t insertSortedBatch(Iterator first, Iterator last) {
+        size_t batchSize = static_cast<size_t>(std::distance(first, last));
+        if(batchSize == 0) {
+            return 0;
+        }
+        Iterator lastElement = first;
+        std::advance(lastElement, batchSize - 1);
+        size_t depth = 1;
+        while((size() >> depth) > 0) {
+            ++depth;
+        }
+        size_t affected = rank(*lastElement) - rank(*first);
+        if(batchSize * depth < affected) {
+            size_t inserted = 0;
+            for(; first != last; ++first) {
+                inserted += insertIteratively(*first) != nullptr;
+            }
+            return inserted;
+        }
+
+        // below < first element <= middle <= last element < above
+        TreeNode<T> * below;
+        TreeNode<T> * rest;
+        TreeNode<T> * middle;
+        TreeNode<T> * above;
+        splitSubtree(root.release(), *first, below, rest);
+        TreeNode<T> * equalToLast = splitAround(rest, *lastElement, middle, above);
+        if(equalToLast) {
+            middle = joinSubtrees(middle, equalToLast, nullptr);
+        }
+        size_t inserted = 0;
+        try {
+            middle = mergeIntoSubtree(middle, first, last, inserted);
+        }
+        catch(...) {
+            root.reset(joinSubtrees(joinSubtrees(below, middle), above));
+            throw;
+        }
+        root.reset(joinSubtrees(joinSubtrees(below, middle), above));
+        return inserted;
+    }
+
     // ==================================================================
 
 public:
+
+    typedef TreeNodeIterator<T> iterator;
+    typedef TreeNodeIterator<T, true> const_iterator;
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
     /**
      * Default constructor of the BinarySearchTree with no elements inside.
      */
     BinarySearchTree() = default;
 
+    /**
+     * Constructor of the BinarySearchTree with no elements inside that uses the provided allocator.
+     * @param alloc Allocator to create the TreeNodes with.
+     * @param comp Ordering of the elements.
+     */
+    explicit BinarySearchTree(const Allocator & alloc, const Compare & comp = Compare())
+            : allocator(alloc), comparator(comp), root(nullptr) {
+    }
+
+    /**
+     * Constructor of the BinarySearchTree with no elements inside that orders them with the provided Compare.
+     * @param comp Ordering of the elements.
+     * @param alloc Allocator to create the TreeNodes with.
+     */
+    explicit BinarySearchTree(const Compare & comp, const Allocator & alloc = Allocator())
+            : allocator(alloc), comparator(comp), root(nullptr) {
+    }
+
+    /**
+     * Move constructor, takes over the TreeNodes of the other BinarySearchTree and leaves it empty.
+     * @param other BinarySearchTree to move from.
+     */
+    BinarySearchTree(BinarySearchTree && other) noexcept
+            : allocator(other.allocator), comparator(other.comparator), root(std::move(other.root)) {
+    }
+
+    /**
+     * Build a height-balanced BinarySearchTree out of a sorted sequence of distinct elements in O(n), without any
+     * comparisons or rotations. The sequence must already be sorted with no duplicates, see fromUnsorted otherwise.
+     * @param first Forward iterator to the first element.
+     * @param last Forward iterator past the last element.
+     * @param alloc Allocator to create the TreeNodes with.
+     * @param comp Ordering the sequence is sorted by.
+     * @return The new BinarySearchTree.
+     */
+    template<typename Iterator>
+    static BinarySearchTree fromSorted(Iterator first, Iterator last, const Allocator & alloc = Allocator(),
+                                       const Compare & comp = Compare()) {
+        BinarySearchTree tree(alloc, comp);
+        tree.root.reset(tree.buildSorted(first, static_cast<size_t>(std::distance(first, last))));
+        return tree;
+    }
+
+    /**
+     * Parallel version of fromSorted, building the subtrees on up to the provided number of threads. The TreeNodes
+     * are created concurrently, so this is only done for stateless allocators (such as std::allocator), which are
+     * expected to be thread-safe; with any other allocator the tree is built on the calling thread.
+     * @param first Random access iterator to the first element.
+     * @param last Random access iterator past the last element.
+     * @param threads Number of threads to use.
+     * @param alloc Allocator to create the TreeNodes with.
+     * @param comp Ordering the sequence is sorted by.
+     * @return The new BinarySearchTree.
+     */
+    template<typename Iterator>
+    static BinarySearchTree fromSorted(Iterator first, Iterator last, unsigned threads,
+                                       const Allocator & alloc = Allocator(), const Compare & comp = Compare()) {
+        BinarySearchTree tree(alloc, comp);
+        if(!std::is_empty<NodeAllocator>::value) {
+            threads = 1;
+        }
+        tree.root.reset(tree.buildSortedInParallel(first, static_cast<size_t>(last - first), threads));
+        return tree;
+    }
+
+    /**
+     * Checked version of fromSorted: the elements are copied and, unless they already are sorted with no
+     * duplicates, sorted and deduplicated before building the tree, so the sequence can be in any order.
+     * @param first Iterator to the first element.
+     * @param last Iterator past the last element.
+     * @param alloc Allocator to create the TreeNodes with.
+     * @param comp Ordering of the elements.
+     * @return The new BinarySearchTree.
+     */
+    template<typename Iterator>
+    static BinarySearchTree fromUnsorted(Iterator first, Iterator last, const Allocator & alloc = Allocator(),
+                                         const Compare & comp = Compare()) {
+        std::vector<T> elements(first, last);
+        sortUnique(elements, comp);
+        return fromSorted(std::make_move_iterator(elements.begin()), std::make_move_iterator(elements.end()), alloc,
+                          comp);
+    }
+
+    /**
+     * Check whether a sequence is sorted and has no duplicates, using only the Compare.
+     * @param first Iterator to the first element.
+     * @param last Iterator past the last element.
+     * @param comp Ordering of the elements.
+     * @return true if every element is smaller than the one after it.
+     */
+    template<typename Iterator>
+    static bool isStrictlySorted(Iterator first, Iterator last, const Compare & comp = Compare()) {
+        return std::adjacent_find(first, last, [&](const T & a, const T & b) { return !comp(a, b); }) == last;
+    }
+
+    /**
+     * Get the ordering of the elements.
+     * @return copy of the Compare.
+     */
+    Compare key_comp() const{
+        return comparator;
+    }
+
+    /**
+     * Remove every element from the BinarySearchTree.
+     * Walks down to a leaf, frees it and climbs back up to its parent, so it needs no recursion and no extra memory.
+     */
+    void clear() {
+        destroySubtree(root.release());
+    }
+
+    /**
+     * Deconstructor. With an allocator that frees all of its memory at once (such as ArenaAllocator) and trivially
+     * destructible data there is nothing to do per TreeNode, so the TreeNodes are simply left to the allocator, but
+     * only if no other tree or allocator shares its memory: otherwise the TreeNodes are given back to be reused.
+     */
+    ~BinarySearchTree() {
+        if(std::is_trivially_destructible<T>::value
+           && AllocatorFreesInBulk<NodeAllocator>::whenDestroyed(allocator)) {
+            root.release();
+        }
+        else {
+            clear();
+        }
+    }
+
     /**
      * Get the tree representation.
      * @param o ostream object.
      */
     void write(ostream& o) const{
-       if(root) {
-           root->write(o);
-       }
+        auto spaced = [](BufferedSink & sink, const T & data) {
+            sink.append(' ');
+            sink.appendValue(data);
+            sink.append(' ');
+        };
+        writeElements<T>(o, nullptr, nullptr, std::string(), spaced);
+    }
+
+    /**
+     * Write every element in order through a BufferedSink, with the separator between them. Needs no recursion,
+     * and hands the output to the ostream in blocks of 64 KiB.
+     * @param o ostream object.
+     * @param separator Written between two elements.
+     * @param format Function taking the BufferedSink and an element that writes the element, StreamFormatter by
+     * default, which uses operator<<.
+     */
+    template<typename Formatter = StreamFormatter>
+    void write(ostream & o, const std::string & separator, Formatter format = Formatter()) const{
+        writeElements<T>(o, nullptr, nullptr, separator, format);
+    }
+
+    /**
+     * Write every element in [lo, hi) in order, like write, in O(log n + k).
+     * @param o ostream object.
+     * @param lo Smallest element to write.
+     * @param hi Smallest element not to write.
+     * @param separator Written between two elements.
+     * @param format Function taking the BufferedSink and an element that writes the element.
+     */
+    template<typename K, typename Formatter = StreamFormatter>
+    void writeRange(ostream & o, const K & lo, const K & hi, const std::string & separator,
+                    Formatter format = Formatter()) const{
+        writeElements<K>(o, &lo, &hi, separator, format);
+    }
+
+    /**
+     * Call the function on every element in order. Faster than iterating, because the nodes are visited with a
+     * fixed-size stack instead of climbing parent pointers.
+     * @param fn Function taking a reference to an element.
+     */
+    template<typename Fn>
+    void forEach(Fn fn) {
+        scanNodes<TreeNode<T>, T>(root.get(), nullptr, nullptr, fn, comparator);
+    }
+
+    template<typename Fn>
+    void forEach(Fn fn) const{
+        scanNodes<const TreeNode<T>, T>(root.get(), nullptr, nullptr, fn, comparator);
+    }
+
+    /**
+     * Call the function on every element in [lo, hi) in order, like forEach, in O(log n + k).
+     * @param lo Smallest element to visit.
+     * @param hi Smallest element not to visit.
+     * @param fn Function taking a reference to an element.
+     */
+    template<typename K, typename Fn>
+    void scan(const K & lo, const K & hi, Fn fn) {
+        scanNodes<TreeNode<T>, K>(root.get(), &lo, &hi, fn, comparator);
+    }
+
+    template<typename K, typename Fn>
+    void scan(const K & lo, const K & hi, Fn fn) const{
+        scanNodes<const TreeNode<T>, K>(root.get(), &lo, &hi, fn, comparator);
     }
 
     /**
@@ -239,70 +1284,438 @@ public:
      * @param data Data element which to insert.
      * @return Pointer to the TreeNode with the provided data element, nullptr if the data already exists in the BST.
      */
-    TreeNode<T> * insert(const T data) {
-        if(root) {
-            TreeNode<T> * pointer = insertRecursively(root.get(), data);
-            if(pointer) {
-                checkBalance(pointer);
+    TreeNode<T> * insert(const T & data) {
+        return insertIteratively(data);
+    }
+
+    /**
+     * Insert element to the BinarySearchTree, moving it into the new TreeNode.
+     * @param data Data element which to insert.
+     * @return Pointer to the TreeNode with the provided data element, nullptr if the data already exists in the BST.
+     */
+    TreeNode<T> * insert(T && data) {
+        return insertIteratively(std::move(data));
+    }
+
+    /**
+     * Construct an element in place, inside a new TreeNode, from the provided arguments and insert it.
+     * The element has to be constructed before it can be compared, so it is destroyed again if an equal one
+     * already exists.
+     * @param args Arguments to pass to the constructor of T.
+     * @return Pointer to the new TreeNode, nullptr if an equal element already exists in the BST.
+     */
+    template<typename... Args>
+    TreeNode<T> * emplace(Args && ... args) {
+        TreeNode<T> * node = createNode(ConstructInPlace(), std::forward<Args>(args)...);
+        TreeNode<T> * parent;
+        bool left;
+        if(findInsertPosition(node->data, parent, left)) {
+            destroyNode(node);
+            return nullptr;
+        }
+        return attachNode(node, parent, left);
+    }
+
+    /**
+     * Look for an element equal to the key and, only if there is none, construct one in place from the provided
+     * arguments. Nothing is constructed when the key is already there.
+     * @param key Anything that can be compared with T, such as the Key of a KeyValuePair.
+     * @param args Arguments to pass to the constructor of T, which must produce an element equal to the key.
+     * @return Pointer to the TreeNode holding the element equal to the key, and true if it was newly inserted.
+     */
+    template<typename K, typename... Args>
+    std::pair<TreeNode<T> *, bool> emplaceIfAbsent(const K & key, Args && ... args) {
+        TreeNode<T> * parent;
+        bool left;
+        TreeNode<T> * existing = findInsertPosition(key, parent, left);
+        if(existing) {
+            return std::make_pair(existing, false);
+        }
+        TreeNode<T> * node = createNode(ConstructInPlace(), std::forward<Args>(args)...);
+        return std::make_pair(attachNode(node, parent, left), true);
+    }
+
+    /**
+     * Insert a batch of elements in any order. The batch is sorted first; a batch that is small next to the part of
+     * the BST it falls into is inserted one by one, a bigger one is merged with that part, whose TreeNodes are
+     * relinked into a perfectly balanced subtree without being copied, in O(k + m + log n) for a batch of m elements
+     * and k elements of the BST between its first and last one.
+     * @param first Iterator to the first element.
+     * @param last Iterator past the last element.
+     * @return number of elements inserted, elements that were already in the BST are left out.
+     */
+    template<typename Iterator>
+    size_t insertBatch(Iterator first, Iterator last) {
+        std::vector<T> elements(first, last);
+        sortUnique(elements, comparator);
+        return insertSortedBatch(std::make_move_iterator(elements.begin()), std::make_move_iterator(elements.end()));
+    }
+
+    /**
+     * Split the BinarySearchTree at the key in O(log n): this BST keeps the elements smaller than the key and the
+     * rest are moved, without copying, into the returned one, which shares the allocator of this BST.
+     * @param key Data element, or anything that can be compared with T.
+     * @return BinarySearchTree of the elements not smaller than the key.
+     */
+    template<typename K>
+    BinarySearchTree split(const K & key) {
+        Allocator alloc(allocator);
+        BinarySearchTree notSmaller(alloc, comparator);
+        TreeNode<T> * smallerRoot;
+        TreeNode<T> * notSmallerRoot;
+        splitSubtree(root.release(), key, smallerRoot, notSmallerRoot);
+        root.reset(smallerRoot);
+        notSmaller.root.reset(notSmallerRoot);
+        return notSmaller;
+    }
+
+    /**
+     * Move every element of the other BinarySearchTree into this one. If all elements of one tree are smaller than
+     * all elements of the other and the allocators are equal, the TreeNodes are linked in O(log n); with different
+     * allocators the elements are moved into new TreeNodes in O(n + m) instead.
+     * @param other BinarySearchTree to take the elements from, left empty if the join succeeds.
+     * @return true if the trees were joined, false (and both are left as they were) if their elements overlap.
+     */
+    bool join(BinarySearchTree && other) {
+        if(!other.root) {
+            return true;
+        }
+        if(!root) {
+            if(allocator == other.allocator) {
+                root = std::move(other.root);
+                return true;
             }
-            return pointer;
         }
         else {
-            root.reset(new TreeNode<T>(data));
-            return root.get();
+            bool thisIsSmaller = isLess(root->findRightmostChild()->data, other.root->findLeftmostChild()->data);
+            if(!thisIsSmaller && !isLess(other.root->findRightmostChild()->data, root->findLeftmostChild()->data)) {
+                return false;
+            }
+            if(allocator == other.allocator) {
+                BinarySearchTree & greater = thisIsSmaller ? other : *this;
+                TreeNode<T> * middle = greater.root->findLeftmostChild();
+                greater.unlinkNode(middle);
+                TreeNode<T> * leftRoot = thisIsSmaller ? root.release() : other.root.release();
+                TreeNode<T> * rightRoot = thisIsSmaller ? other.root.release() : root.release();
+                root.reset(joinSubtrees(leftRoot, middle, rightRoot));
+                return true;
+            }
         }
+        insertSortedBatch(std::make_move_iterator(other.begin()), std::make_move_iterator(other.end()));
+        other.clear();
+        return true;
+    }
+
+    /**
+     * Copy the elements into an immutable FrozenBinarySearchTree in O(n), for a tree that is only searched from
+     * now on: it keeps them in one array in Eytzinger order, where find and lower_bound touch far fewer cache lines
+     * than following the TreeNodes. This BinarySearchTree does not change.
+     * @return the FrozenBinarySearchTree.
+     */
+    FrozenBinarySearchTree<T, Compare> freeze() const{
+        return FrozenBinarySearchTree<T, Compare>(cbegin(), cend(), comparator);
+    }
+
+    /**
+     * Add every element of the other BinarySearchTree to this one, keeping this tree's element where both have an
+     * equal one, by splitting and joining rather than inserting. Takes O(m log(n / m + 1)) work, which is spread over
+     * up to the provided number of threads; each thread only relinks existing TreeNodes and the duplicates are freed
+     * on the calling thread, so the allocator is never used concurrently.
+     * @param other BinarySearchTree whose TreeNodes to take over, left empty.
+     * @param threads Number of threads to use.
+     */
+    void unionWith(BinarySearchTree && other, unsigned threads = 1) {
+        combineWith(SetOperation::Union, std::move(other), threads);
+    }
+
+    /**
+     * Copying version of unionWith, the other BinarySearchTree is copied first.
+     * @param other BinarySearchTree whose elements to add.
+     * @param threads Number of threads to use.
+     */
+    void unionWith(const BinarySearchTree & other, unsigned threads = 1) {
+        unionWith(BinarySearchTree(other), threads);
+    }
+
+    /**
+     * Keep only the elements that the other BinarySearchTree has too, see unionWith.
+     * @param other BinarySearchTree to intersect with, left empty.
+     * @param threads Number of threads to use.
+     */
+    void intersect(BinarySearchTree && other, unsigned threads = 1) {
+        combineWith(SetOperation::Intersection, std::move(other), threads);
+    }
+
+    /**
+     * Copying version of intersect, the other BinarySearchTree is copied first.
+     * @param other BinarySearchTree to intersect with.
+     * @param threads Number of threads to use.
+     */
+    void intersect(const BinarySearchTree & other, unsigned threads = 1) {
+        intersect(BinarySearchTree(other), threads);
+    }
+
+    /**
+     * Remove every element that the other BinarySearchTree has, see unionWith.
+     * @param other BinarySearchTree whose elements to remove, left empty.
+     * @param threads Number of threads to use.
+     */
+    void difference(BinarySearchTree && other, unsigned threads = 1) {
+        combineWith(SetOperation::Difference, std::move(other), threads);
     }
 
     /**
-     * Look for the data element in the BinarySearchTree.
-     * @param data Data element which to look for.
+     * Copying version of difference, the other BinarySearchTree is copied first.
+     * @param other BinarySearchTree whose elements to remove.
+     * @param threads Number of threads to use.
+     */
+    void difference(const BinarySearchTree & other, unsigned threads = 1) {
+        difference(BinarySearchTree(other), threads);
+    }
+
+    /**
+     * Look for the data element in the BinarySearchTree, with one comparison per level.
+     * @param key Data element, or anything that can be compared with T, so that no T has to be built.
      * @return Pointer to the TreeNode containing the provided data, nullptr if the data does not exist in the BST.
      */
-    TreeNode<T> * find(const T data) const{
-        if(root) {
-            return findRecursively(root.get(), data);
+    template<typename K = T>
+    TreeNode<T> * find(const K & key) const{
+        TreeNode<T> * node = root.get();
+        while(node) {
+            int order = threeWay(key, node->data);
+            if(order == 0) {
+                return node;
+            }
+            node = (order < 0 ? node->leftChild : node->rightChild).get();
         }
-        else {
-            return nullptr;
+        return nullptr;
+    }
+
+    /**
+     * Remove the data element from the BinarySearchTree and rebalance it.
+     * @param key Data element, or anything that can be compared with T.
+     * @return true if the data was in the BST and got removed, false otherwise.
+     */
+    template<typename K = T>
+    typename std::enable_if<!std::is_convertible<const K &, const_iterator>::value, bool>::type
+    erase(const K & key) {
+        TreeNode<T> * node = find(key);
+        if(node) {
+            eraseNode(node);
+            return true;
         }
+        return false;
+    }
+
+    /**
+     * Remove the element the TreeNodeIterator points to from the BinarySearchTree and rebalance it.
+     * Iterators to the other elements stay valid.
+     * @param position TreeNodeIterator pointing to an element of this BST.
+     * @return TreeNodeIterator pointing to the element that followed the removed one.
+     */
+    iterator erase(const_iterator position) {
+        return iterator(eraseNode(const_cast<TreeNode<T> *>(position.getNode())), &root);
+    }
+
+    /**
+     * Get the number of elements in the BinarySearchTree.
+     * Every TreeNode caches the size of its subtree, so this is O(1).
+     * @return number of elements.
+     */
+    size_t size() const{
+        return root ? root->size : 0;
+    }
+
+    /**
+     * Count the elements smaller than the key, in O(log n).
+     * @param key Data element, or anything that can be compared with T.
+     * @return number of elements smaller than the key, which is the position of the key if it is in the BST.
+     */
+    template<typename K>
+    size_t rank(const K & key) const{
+        size_t smaller = 0;
+        TreeNode<T> * node = root.get();
+        while(node) {
+            int order = threeWay(key, node->data);
+            if(order < 0) {
+                node = node->leftChild.get();
+            }
+            else {
+                size_t leftSize = node->leftChild ? node->leftChild->size : 0;
+                if(order > 0) {
+                    smaller += leftSize + 1;
+                    node = node->rightChild.get();
+                }
+                else {
+                    return smaller + leftSize;
+                }
+            }
+        }
+        return smaller;
+    }
+
+    /**
+     * Find the k-th smallest element, in O(log n).
+     * @param k Position of the element, starting from 0.
+     * @return Pointer to the TreeNode holding the k-th smallest element, nullptr if k is not smaller than size().
+     */
+    TreeNode<T> * select(size_t k) const{
+        TreeNode<T> * node = root.get();
+        while(node) {
+            size_t leftSize = node->leftChild ? node->leftChild->size : 0;
+            if(k < leftSize) {
+                node = node->leftChild.get();
+            }
+            else if(k == leftSize) {
+                return node;
+            }
+            else {
+                k -= leftSize + 1;
+                node = node->rightChild.get();
+            }
+        }
+        return nullptr;
     }
 
     /**
      * Get maximum depth of the BinarySearchTree.
-     * @return max depth of the BST.
+     * The height is cached in the root, so this is O(1).
+     * @return max depth of the BST, 0 if the BST is empty.
      */
     int maxDepth() const{
-        return root->maxDepth();
+        return root ? root->height : 0;
+    }
+
+    /**
+     * Find the first element that is not smaller than the key, in O(log n).
+     * @param key Data element, or anything that can be compared with T.
+     * @return TreeNodeIterator pointing to the element, end() if every element is smaller than the key.
+     */
+    template<typename K>
+    iterator lower_bound(const K & key) {
+        return iterator(findLowerBound(key), &root);
+    }
+
+    template<typename K>
+    const_iterator lower_bound(const K & key) const{
+        return const_iterator(findLowerBound(key), &root);
+    }
+
+    /**
+     * Find the first element that is greater than the key, in O(log n).
+     * @param key Data element, or anything that can be compared with T.
+     * @return TreeNodeIterator pointing to the element, end() if no element is greater than the key.
+     */
+    template<typename K>
+    iterator upper_bound(const K & key) {
+        return iterator(findUpperBound(key), &root);
+    }
+
+    template<typename K>
+    const_iterator upper_bound(const K & key) const{
+        return const_iterator(findUpperBound(key), &root);
+    }
+
+    /**
+     * Find the elements equal to the key, in O(log n).
+     * @param key Data element, or anything that can be compared with T.
+     * @return lower_bound and upper_bound of the key, equal to each other if the key is not in the BST.
+     */
+    template<typename K>
+    std::pair<iterator, iterator> equal_range(const K & key) {
+        return std::make_pair(lower_bound(key), upper_bound(key));
+    }
+
+    template<typename K>
+    std::pair<const_iterator, const_iterator> equal_range(const K & key) const{
+        return std::make_pair(lower_bound(key), upper_bound(key));
     }
 
     /**
-     * Get a TreeNodeIterator pointing to the first element of the tree.
+     * Get a view of the elements in [lo, hi), found in O(log n), so that scanning it costs O(log n + k).
+     * @param lo Smallest element to include.
+     * @param hi Smallest element to exclude.
+     * @return TreeNodeRange of the elements not smaller than lo and smaller than hi, empty if hi is not greater than lo.
+     */
+    template<typename K>
+    TreeNodeRange<T> range(const K & lo, const K & hi) {
+        if(!isLess(lo, hi)) {
+            return TreeNodeRange<T>(end(), end(), 0);
+        }
+        return TreeNodeRange<T>(lower_bound(lo), lower_bound(hi), rank(hi) - rank(lo));
+    }
+
+    template<typename K>
+    TreeNodeRange<T, true> range(const K & lo, const K & hi) const{
+        if(!isLess(lo, hi)) {
+            return TreeNodeRange<T, true>(end(), end(), 0);
+        }
+        return TreeNodeRange<T, true>(lower_bound(lo), lower_bound(hi), rank(hi) - rank(lo));
+    }
+
+    /**
+     * Get a TreeNodeIterator pointing to the first element of the tree, in O(log n).
      * @return TreeNodeIterator pointing to the beginning of the tree.
      */
-    TreeNodeIterator<T> begin() const{
-      TreeNode<T> * firstElement;
-      if(root) {
-          firstElement = root->findLeftmostChild();
-      }
-      else {
-          firstElement = nullptr;
-      }
-      return TreeNodeIterator<T>(firstElement);
+    iterator begin() {
+        return iterator(root ? root->findLeftmostChild() : nullptr, &root);
+    }
+
+    const_iterator begin() const{
+        return const_iterator(root ? root->findLeftmostChild() : nullptr, &root);
+    }
+
+    const_iterator cbegin() const{
+        return begin();
     }
 
     /**
-     * Get a TreeNodeIterator pointing to the next element of the last element of the tree.
+     * Get a TreeNodeIterator pointing to the next element of the last element of the tree, in O(1).
+     * Decrementing it gives the last element. It stops working if the tree itself is moved.
      * @return TreeNodeIterator pointing to the end of the tree.
      */
-    TreeNodeIterator<T> end() const{
-      TreeNode<T> * lastElement;
-      if(root) {
-          lastElement = root->findRightmostChild();
-          return TreeNodeIterator<T>(lastElement->rightChild.get());
-      }
-      else {
-          return TreeNodeIterator<T>(nullptr);
-      }
+    iterator end() {
+        return iterator(nullptr, &root);
+    }
+
+    const_iterator end() const{
+        return const_iterator(nullptr, &root);
+    }
+
+    const_iterator cend() const{
+        return end();
+    }
+
+    /**
+     * Get a reverse iterator pointing to the last element of the tree.
+     * @return reverse iterator pointing to the beginning of the reversed tree.
+     */
+    reverse_iterator rbegin() {
+        return reverse_iterator(end());
+    }
+
+    const_reverse_iterator rbegin() const{
+        return const_reverse_iterator(end());
+    }
+
+    const_reverse_iterator crbegin() const{
+        return rbegin();
+    }
+
+    /**
+     * Get a reverse iterator pointing to the previous element of the first element of the tree.
+     * @return reverse iterator pointing to the end of the reversed tree.
+     */
+    reverse_iterator rend() {
+        return reverse_iterator(begin());
+    }
+
+    const_reverse_iterator rend() const{
+        return const_reverse_iterator(begin());
+    }
+
+    const_reverse_iterator crend() const{
+        return rend();
     }
 
     /**
@@ -311,19 +1724,48 @@ public:
      * @return An updated BinarySearchTree.
      */
     BinarySearchTree & operator=(const BinarySearchTree & other) {
-        root.reset(new TreeNode<T>(other.root->data));
-        copyRecursively(root.get(), other.root.get());
+        if(this != &other) {
+            clear();
+            comparator = other.comparator;
+            copyFrom(other.root.get());
+        }
+        return *this;
+    }
+
+    /**
+     * Move assignment, takes over the TreeNodes of the other BinarySearchTree and leaves it empty.
+     * If the allocators do not propagate on move and are not equal, the TreeNodes of the other BinarySearchTree can
+     * not be freed through ours, so they are copied instead.
+     * @param other BinarySearchTree to move from.
+     * @return An updated BinarySearchTree.
+     */
+    BinarySearchTree & operator=(BinarySearchTree && other)
+            noexcept(NodeAllocatorTraits::propagate_on_container_move_assignment::value) {
+        if(this != &other) {
+            clear();
+            comparator = other.comparator;
+            if(NodeAllocatorTraits::propagate_on_container_move_assignment::value || allocator == other.allocator) {
+                if(NodeAllocatorTraits::propagate_on_container_move_assignment::value) {
+                    allocator = other.allocator;
+                }
+                root = std::move(other.root);
+            }
+            else {
+                copyFrom(other.root.get());
+                other.clear();
+            }
+        }
         return *this;
     }
 
     /**
-     * Copy constructor.
+     * Copy constructor, copies the shape and the cached heights of the other BinarySearchTree in O(n).
      * @param other BinarySearchTree to make a copy of.
      */
     BinarySearchTree(const BinarySearchTree & other)
-            : root(nullptr) {
-        root.reset(new TreeNode<T>(other.root->data));
-        copyRecursively(root.get(), other.root.get());
+            : allocator(NodeAllocatorTraits::select_on_container_copy_construction(other.allocator)),
+              comparator(other.comparator), root(nullptr) {
+        copyFrom(other.root.get());
     }
 
 };
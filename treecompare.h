@@ -0,0 +1,132 @@
+#ifndef TREECOMPARE_H
+#define TREECOMPARE_H
+
+#include <string>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Default ordering of the trees: compares any two things with operator<, so that a tree of T can be searched by
+ * anything that can be compared with T (such as the Key of a KeyValuePair) without building a T.
+ *
+ * @author Vakaris Paulavičius (K20062023)
+ * @version 1.0
+ */
+struct TreeLess {
+
+    template<typename A, typename B>
+    bool operator()(const A & a, const B & b) const{
+        return a < b;
+    }
+
+};
+
+/**
+ * Check whether the ordering is plain operator<, for which ThreeWayCompare may use the types' own comparisons.
+ */
+template<typename Compare>
+struct IsPlainLess : std::false_type {
+};
+
+template<>
+struct IsPlainLess<TreeLess> : std::true_type {
+};
+
+/**
+ * Check whether the type is a std::basic_string, whose compare member orders the same way as its operator<.
+ */
+template<typename T>
+struct IsBasicString : std::false_type {
+};
+
+template<typename CharT, typename Traits, typename Alloc>
+struct IsBasicString<std::basic_string<CharT, Traits, Alloc> > : std::true_type {
+};
+
+/**
+ * Check whether the type can be the result of a three-way comparison: a signed integral type other than bool, so that
+ * a compare member that is really a less-than predicate is not taken for one.
+ */
+template<typename R>
+struct IsThreeWayResult
+        : std::integral_constant<bool, std::is_integral<R>::value && std::is_signed<R>::value
+                                       && !std::is_same<R, bool>::value> {
+};
+
+/**
+ * Priority tag of the overloads of ThreeWayCompare, which are tried from the highest rank down.
+ */
+template<int N>
+struct ThreeWayRank : ThreeWayRank<N - 1> {
+};
+
+template<>
+struct ThreeWayRank<0> {
+};
+
+// ====================================================================================================================
+
+/**
+ * ThreeWayCompare tells with a single comparison whether a is smaller than, equal to or greater than b, so that a
+ * search does one comparison per level instead of testing a < b and then b < a. The first of these that applies is
+ * used:
+ * - the Compare has a compare(a, b) member returning a signed integer (the three-way form of a custom ordering),
+ * - the ordering is plain operator< on two arithmetic types, compared without a branch,
+ * - the ordering is plain operator< and a is a std::basic_string, compared with its compare(b) member,
+ * - otherwise Compare is called twice, like before.
+ * @tparam Compare Ordering of the tree, a function object returning whether its first argument is smaller.
+ *
+ * @author Vakaris Paulavičius (K20062023)
+ * @version 1.0
+ */
+template<typename Compare>
+class ThreeWayCompare {
+
+private:
+
+    // C is always Compare, it is a template parameter so that a Compare without a compare member is not an error
+    template<typename C, typename A, typename B>
+    static auto dispatch(const C & comparator, const A & a, const B & b, ThreeWayRank<3>)
+            -> typename std::enable_if<IsThreeWayResult<decltype(comparator.compare(a, b))>::value, int>::type {
+        // Only the sign counts, and a wider result such as a long difference must not be cut down to int
+        auto order = comparator.compare(a, b);
+        return static_cast<int>(order > 0) - static_cast<int>(order < 0);
+    }
+
+    template<typename A, typename B>
+    static typename std::enable_if<IsPlainLess<Compare>::value && std::is_arithmetic<A>::value
+                                   && std::is_arithmetic<B>::value, int>::type
+    dispatch(const Compare &, const A & a, const B & b, ThreeWayRank<2>) {
+        // Both results are materialised as 0 or 1, so the compiler emits two setcc and no jump
+        return static_cast<int>(b < a) - static_cast<int>(a < b);
+    }
+
+    template<typename A, typename B>
+    static auto dispatch(const Compare &, const A & a, const B & b, ThreeWayRank<1>)
+            -> typename std::enable_if<IsPlainLess<Compare>::value && IsBasicString<A>::value,
+                                       decltype(static_cast<int>(a.compare(b)))>::type {
+        return a.compare(b);
+    }
+
+    template<typename A, typename B>
+    static int dispatch(const Compare & comparator, const A & a, const B & b, ThreeWayRank<0>) {
+        return comparator(a, b) ? -1 : (comparator(b, a) ? 1 : 0);
+    }
+
+public:
+
+    /**
+     * Compare a with b.
+     * @param comparator The ordering.
+     * @param a First thing to compare.
+     * @param b Second thing to compare.
+     * @return a negative number if a is smaller than b, 0 if they are equal and a positive number if a is greater.
+     */
+    template<typename A, typename B>
+    static int compare(const Compare & comparator, const A & a, const B & b) {
+        return dispatch(comparator, a, b, ThreeWayRank<3>());
+    }
+
+};
+
+#endif
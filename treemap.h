@@ -3,6 +3,9 @@
 
 #include "tree.h"
 
+#include <cstdint>
+#include <cstring>
+
 /**
  * This class represents a Key --> Value pair.
  * @tparam Key Key object.
@@ -25,7 +28,33 @@ public:
      * @param v Value.
      */
     KeyValuePair(Key k, Value v)
-        : k(k), v(std::move(v)) {
+        : k(std::move(k)), v(std::move(v)) {
+    }
+
+    /**
+     * Constructor that builds the Value in place from the provided arguments, without any temporary Value.
+     * @param key Key, forwarded into k.
+     * @param args Arguments to pass to the constructor of Value.
+     */
+    template<typename K, typename... Args>
+    KeyValuePair(ConstructInPlace, K && key, Args && ... args)
+        : k(std::forward<K>(key)), v(std::forward<Args>(args)...) {
+    }
+
+    /**
+     * Constructor from a std::pair, so that sequences of pairs (e.g. from a std::map) can be loaded into a TreeMap.
+     * @param p Pair of the Key and the Value.
+     */
+    KeyValuePair(const std::pair<Key,Value> & p)
+        : k(p.first), v(p.second) {
+    }
+
+    /**
+     * Constructor from a std::pair that moves the Key and the Value out of it.
+     * @param p Pair of the Key and the Value.
+     */
+    KeyValuePair(std::pair<Key,Value> && p)
+        : k(std::move(p.first)), v(std::move(p.second)) {
     }
 
     /**
@@ -33,7 +62,7 @@ public:
      * @param k Key.
      */
     explicit KeyValuePair(Key k)
-        : k(k) {
+        : k(std::move(k)) {
     }
 
     /**
@@ -41,7 +70,7 @@ public:
      * @param other KeyValuePair to compare to.
      * @return true if this Key is smaller than the Key of the provided KeyValuePair.
      */
-    bool operator <(const KeyValuePair other) const{
+    bool operator <(const KeyValuePair & other) const{
         return k < other.k;
     }
 
@@ -50,11 +79,28 @@ public:
      * @param other KeyValuePair to compare to.
      * @return true if Keys are the same, false otherwise.
      */
-    bool operator ==(const KeyValuePair other) const {
+    bool operator ==(const KeyValuePair & other) const {
         return k == other.k;
     }
 };
 
+/**
+ * Check if the Key is smaller than the Key of the KeyValuePair, so that a BinarySearchTree of KeyValuePairs can be
+ * searched by Key alone.
+ */
+template<typename Key, typename Value>
+bool operator <(const Key & key, const KeyValuePair<Key,Value> & kv) {
+    return key < kv.k;
+}
+
+/**
+ * Check if the Key of the KeyValuePair is smaller than the Key.
+ */
+template<typename Key, typename Value>
+bool operator <(const KeyValuePair<Key,Value> & kv, const Key & key) {
+    return kv.k < key;
+}
+
 template<typename Key, typename Value>
 ostream & operator<< (ostream & o, const KeyValuePair<Key,Value> & kv){
     o << kv.k << "," << kv.v;
@@ -63,24 +109,419 @@ ostream & operator<< (ostream & o, const KeyValuePair<Key,Value> & kv){
 
 // ====================================================================================================================
 
+/**
+ * Ordering of the KeyValuePairs of a TreeMap by their Keys alone, so that the BinarySearchTree inside can be searched
+ * by a Key without building a KeyValuePair. Its compare members let ThreeWayCompare compare the Keys with a single
+ * comparison whenever the Compare of the Keys allows it.
+ * @tparam Key Key of the KeyValuePair.
+ * @tparam Value Value of the KeyValuePair.
+ * @tparam Compare Ordering of the Keys.
+ *
+ * @author Vakaris Paulavičius (K20062023)
+ * @version 1.0
+ */
+template<typename Key, typename Value, typename Compare>
+struct KeyValueCompare {
+
+    Compare keyCompare;
+
+    /**
+     * Constructor of the ordering.
+     * @param comp Ordering of the Keys.
+     */
+    explicit KeyValueCompare(const Compare & comp = Compare())
+        : keyCompare(comp) {
+    }
+
+    bool operator()(const KeyValuePair<Key,Value> & a, const KeyValuePair<Key,Value> & b) const{
+        return keyCompare(a.k, b.k);
+    }
+
+    bool operator()(const Key & a, const KeyValuePair<Key,Value> & b) const{
+        return keyCompare(a, b.k);
+    }
+
+    bool operator()(const KeyValuePair<Key,Value> & a, const Key & b) const{
+        return keyCompare(a.k, b);
+    }
+
+    bool operator()(const Key & a, const Key & b) const{
+        return keyCompare(a, b);
+    }
+
+    /**
+     * Compare the Keys of a and b with a single comparison, see ThreeWayCompare.
+     * @return a negative number if the Key of a is smaller, 0 if the Keys are equal and a positive number otherwise.
+     */
+    int compare(const KeyValuePair<Key,Value> & a, const KeyValuePair<Key,Value> & b) const{
+        return ThreeWayCompare<Compare>::compare(keyCompare, a.k, b.k);
+    }
+
+    int compare(const Key & a, const KeyValuePair<Key,Value> & b) const{
+        return ThreeWayCompare<Compare>::compare(keyCompare, a, b.k);
+    }
+
+    int compare(const KeyValuePair<Key,Value> & a, const Key & b) const{
+        return ThreeWayCompare<Compare>::compare(keyCompare, a.k, b);
+    }
+
+    int compare(const Key & a, const Key & b) const{
+        return ThreeWayCompare<Compare>::compare(keyCompare, a, b);
+    }
+
+};
+
+// ====================================================================================================================
+
+
+/**
+ * Header of the binary snapshot of a TreeMap, written by TreeMap::writeBinary. It is followed by the Keys in order
+ * at keysOffset and by their Values at valuesOffset, both aligned to 16 bytes, so that the snapshot can be read back
+ * into a TreeMap in O(n) or searched in place once it is mapped into memory (see MappedTreeMap).
+ * Keys and Values are stored as their raw bytes, so the snapshot can only be read on a machine with the same
+ * byte order and the same Key and Value types.
+ *
+ * @author Vakaris Paulavičius (K20062023)
+ * @version 1.0
+ */
+struct TreeMapFileHeader {
+
+    static const uint32_t currentVersion = 1;
+    static const uint32_t byteOrderMark = 0x01020304;
+    static const uint64_t alignment = 16;
+
+    char magic[8];
+    uint32_t byteOrder;
+    uint32_t version;
+    uint32_t keySize;
+    uint32_t valueSize;
+    uint64_t count;
+    uint64_t keysOffset;
+    uint64_t valuesOffset;
+
+    /**
+     * Make the header of a snapshot of count Keys and Values of the provided sizes.
+     * @param keySizeIn sizeof the Key.
+     * @param valueSizeIn sizeof the Value.
+     * @param countIn Number of KeyValuePairs.
+     * @return the header.
+     */
+    static TreeMapFileHeader make(uint32_t keySizeIn, uint32_t valueSizeIn, uint64_t countIn) {
+        TreeMapFileHeader header;
+        std::memcpy(header.magic, "AVLTMAP", 8);
+        header.byteOrder = byteOrderMark;
+        header.version = currentVersion;
+        header.keySize = keySizeIn;
+        header.valueSize = valueSizeIn;
+        header.count = countIn;
+        header.keysOffset = alignUp(sizeof(TreeMapFileHeader));
+        header.valuesOffset = alignUp(header.keysOffset + countIn * keySizeIn);
+        return header;
+    }
+
+    /**
+     * Check that the header describes a snapshot of the provided Key and Value sizes written by this version on a
+     * machine of the same byte order, and that the snapshot fits in fileSize bytes.
+     * @param keySizeIn sizeof the Key.
+     * @param valueSizeIn sizeof the Value.
+     * @param fileSize Number of bytes in the file, including the header.
+     * @return true if the snapshot can be read.
+     */
+    bool isValid(uint32_t keySizeIn, uint32_t valueSizeIn, uint64_t fileSize) const{
+        if(std::memcmp(magic, "AVLTMAP", 8) != 0 || byteOrder != byteOrderMark || version != currentVersion
+           || keySize != keySizeIn || valueSize != valueSizeIn || keySize == 0 || valueSize == 0) {
+            return false;
+        }
+        // Compare counts rather than byte sizes, so that a corrupted count cannot overflow the checks
+        if(keysOffset != alignUp(sizeof(TreeMapFileHeader)) || keysOffset > fileSize
+           || count > (fileSize - keysOffset) / keySize) {
+            return false;
+        }
+        if(valuesOffset != alignUp(keysOffset + count * keySize) || valuesOffset > fileSize) {
+            return false;
+        }
+        return count <= (fileSize - valuesOffset) / valueSize;
+    }
+
+    /**
+     * Round an offset up to the alignment of the Key and Value arrays.
+     */
+    static uint64_t alignUp(uint64_t offset) {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+};
+
+// ====================================================================================================================
+
 
 /**
  * This class represents a TreeMap that has a BinarySearchTree of KeyValuePair's.
  * @tparam Key Key of the KeyValuePair.
  * @tparam Value Value of the KeyValuePair.
+ * @tparam Allocator Allocator used for the TreeNodes of the BinarySearchTree, e.g. ArenaAllocator.
+ * @tparam Compare Ordering of the Keys, TreeLess (operator<) by default.
  *
  * @author Vakaris Paulavičius (K20062023)
- * @version 1.2
+ * @version 1.4
  */
-template<typename Key, typename Value>
+template<typename Key, typename Value, typename Allocator = std::allocator<KeyValuePair<Key,Value> >,
+         typename Compare = TreeLess>
 class TreeMap {
 
 private:
 
-    BinarySearchTree<KeyValuePair<Key,Value> > tree;
+    typedef KeyValueCompare<Key, Value, Compare> PairCompare;
+    typedef BinarySearchTree<KeyValuePair<Key,Value>, Allocator, PairCompare> Tree;
+    // A FrozenBinarySearchTree only ever asks whether one thing is smaller than another, which the operators of
+    // KeyValuePair already answer for the default ordering
+    typedef typename std::conditional<std::is_same<Compare, TreeLess>::value, TreeLess, PairCompare>::type
+            FrozenCompare;
+
+    Tree tree;
+
+    /**
+     * Constructor of the TreeMap that takes over an already built BinarySearchTree.
+     * @param treeIn BinarySearchTree of KeyValuePairs.
+     */
+    explicit TreeMap(Tree && treeIn)
+            : tree(std::move(treeIn)) {
+    }
+
+    /**
+     * Get the ordering a FrozenBinarySearchTree of the KeyValuePairs uses.
+     * @param comp Ordering of the BinarySearchTree inside.
+     * @return comp itself, or TreeLess for the default ordering.
+     */
+    static PairCompare frozenCompare(const PairCompare & comp, std::false_type) {
+        return comp;
+    }
+
+    static TreeLess frozenCompare(const PairCompare &, std::true_type) {
+        return TreeLess();
+    }
+
+    /**
+     * Copy the (Key, Value) std::pairs, sorted by Key, keeping only the first pair with each Key.
+     * @param first Iterator to the first pair.
+     * @param last Iterator past the last pair.
+     * @param comp Ordering of the Keys.
+     * @return the sorted pairs.
+     */
+    template<typename Iterator>
+    static std::vector<std::pair<Key,Value> > sortedByKey(Iterator first, Iterator last, const Compare & comp) {
+        std::vector<std::pair<Key,Value> > pairs(first, last);
+        std::stable_sort(pairs.begin(), pairs.end(),
+                         [&](const std::pair<Key,Value> & a, const std::pair<Key,Value> & b) {
+                             return comp(a.first, b.first);
+                         });
+        pairs.erase(std::unique(pairs.begin(), pairs.end(),
+                                [&](const std::pair<Key,Value> & a, const std::pair<Key,Value> & b) {
+                                    return !comp(a.first, b.first);
+                                }),
+                    pairs.end());
+        return pairs;
+    }
+
+    /**
+     * Write one field of every KeyValuePair in order, copied into a buffer a few thousand at a time.
+     * @param o ostream object.
+     * @param field Function returning the field of a KeyValuePair which to write.
+     */
+    template<typename Field>
+    void writeInChunks(ostream & o, Field field) const{
+        typedef decltype(field(std::declval<const KeyValuePair<Key,Value> &>())) FieldType;
+        std::vector<FieldType> buffer;
+        buffer.reserve(4096);
+        tree.forEach([&](const KeyValuePair<Key,Value> & pair) {
+            buffer.push_back(field(pair));
+            if(buffer.size() == buffer.capacity()) {
+                o.write(reinterpret_cast<const char *>(buffer.data()), buffer.size() * sizeof(FieldType));
+                buffer.clear();
+            }
+        });
+        o.write(reinterpret_cast<const char *>(buffer.data()), buffer.size() * sizeof(FieldType));
+    }
+
+    /**
+     * Read count trivially copyable elements into the vector, growing it as the data arrives, so that a corrupted
+     * count fails on the end of the stream instead of allocating all of the memory it claims up front.
+     * @param in istream object.
+     * @param elements Vector to fill.
+     * @param count Number of elements to read.
+     * @return true if all of them were read.
+     */
+    template<typename E>
+    static bool readArray(std::istream & in, std::vector<E> & elements, uint64_t count) {
+        const uint64_t chunk = 1 << 16;
+        for(uint64_t read = 0; read < count; read += chunk) {
+            size_t now = static_cast<size_t>(count - read < chunk ? count - read : chunk);
+            elements.resize(elements.size() + now);
+            if(!in.read(reinterpret_cast<char *>(elements.data() + elements.size() - now), now * sizeof(E))) {
+                return false;
+            }
+        }
+        return true;
+    }
 
 public:
 
+    typedef typename Tree::iterator iterator;
+    typedef typename Tree::const_iterator const_iterator;
+    typedef typename Tree::reverse_iterator reverse_iterator;
+    typedef typename Tree::const_reverse_iterator const_reverse_iterator;
+
+    /**
+     * Default constructor of the TreeMap with no elements inside.
+     */
+    TreeMap() = default;
+
+    /**
+     * Constructor of the TreeMap with no elements inside that uses the provided allocator.
+     * @param alloc Allocator to create the TreeNodes with.
+     */
+    explicit TreeMap(const Allocator & alloc)
+            : tree(alloc) {
+    }
+
+    /**
+     * Constructor of the TreeMap with no elements inside that orders the Keys with the provided Compare.
+     * @param comp Ordering of the Keys.
+     * @param alloc Allocator to create the TreeNodes with.
+     */
+    explicit TreeMap(const Compare & comp, const Allocator & alloc = Allocator())
+            : tree(alloc, PairCompare(comp)) {
+    }
+
+    /**
+     * Build a height-balanced TreeMap out of a sequence of (Key, Value) std::pairs in O(n). The sequence must be
+     * sorted by Key with no duplicate Keys, see fromUnsorted otherwise.
+     * @param first Forward iterator to the first pair.
+     * @param last Forward iterator past the last pair.
+     * @param alloc Allocator to create the TreeNodes with.
+     * @param comp Ordering the pairs are sorted by.
+     * @return The new TreeMap.
+     */
+    template<typename Iterator>
+    static TreeMap fromSorted(Iterator first, Iterator last, const Allocator & alloc = Allocator(),
+                              const Compare & comp = Compare()) {
+        return TreeMap(Tree::fromSorted(first, last, alloc, PairCompare(comp)));
+    }
+
+    /**
+     * Parallel version of fromSorted, see BinarySearchTree::fromSorted.
+     * @param first Random access iterator to the first pair.
+     * @param last Random access iterator past the last pair.
+     * @param threads Number of threads to use.
+     * @param alloc Allocator to create the TreeNodes with.
+     * @param comp Ordering the pairs are sorted by.
+     * @return The new TreeMap.
+     */
+    template<typename Iterator>
+    static TreeMap fromSorted(Iterator first, Iterator last, unsigned threads, const Allocator & alloc = Allocator(),
+                              const Compare & comp = Compare()) {
+        return TreeMap(Tree::fromSorted(first, last, threads, alloc, PairCompare(comp)));
+    }
+
+    /**
+     * Checked version of fromSorted: the pairs are copied, sorted and deduplicated by Key first (the first pair
+     * with a given Key wins), so the sequence can be in any order.
+     * @param first Iterator to the first pair.
+     * @param last Iterator past the last pair.
+     * @param alloc Allocator to create the TreeNodes with.
+     * @param comp Ordering of the Keys.
+     * @return The new TreeMap.
+     */
+    template<typename Iterator>
+    static TreeMap fromUnsorted(Iterator first, Iterator last, const Allocator & alloc = Allocator(),
+                                const Compare & comp = Compare()) {
+        std::vector<std::pair<Key,Value> > pairs = sortedByKey(first, last, comp);
+        return fromSorted(pairs.begin(), pairs.end(), alloc, comp);
+    }
+
+    /**
+     * Insert a batch of (Key, Value) std::pairs in any order, much faster than inserting them one by one when the
+     * batch is big, see BinarySearchTree::insertBatch. If a Key is in the batch more than once, the first pair
+     * wins; Keys already in the TreeMap keep their Values.
+     * @param first Iterator to the first pair.
+     * @param last Iterator past the last pair.
+     * @return number of KeyValuePairs inserted.
+     */
+    template<typename Iterator>
+    size_t insertBatch(Iterator first, Iterator last) {
+        std::vector<std::pair<Key,Value> > pairs = sortedByKey(first, last, key_comp());
+        std::vector<KeyValuePair<Key,Value> > elements(std::make_move_iterator(pairs.begin()),
+                                                       std::make_move_iterator(pairs.end()));
+        return tree.insertSortedBatch(std::make_move_iterator(elements.begin()),
+                                      std::make_move_iterator(elements.end()));
+    }
+
+    /**
+     * Split the TreeMap at the Key in O(log n), see BinarySearchTree::split. This TreeMap keeps the Keys smaller
+     * than k, the returned one gets the rest.
+     * @param k Key at which to split.
+     * @return TreeMap of the KeyValuePairs whose Keys are not smaller than k.
+     */
+    TreeMap split(const Key & k) {
+        return TreeMap(tree.split(k));
+    }
+
+    /**
+     * Move every KeyValuePair of the other TreeMap into this one in O(log n), see BinarySearchTree::join. Used
+     * together with split to work on disjoint Key ranges separately and put the results back together.
+     * @param other TreeMap to take the KeyValuePairs from, left empty if the join succeeds.
+     * @return true if the TreeMaps were joined, false (and both are left as they were) if their Keys overlap.
+     */
+    bool join(TreeMap && other) {
+        return tree.join(std::move(other.tree));
+    }
+
+    /**
+     * Copy the KeyValuePairs into an immutable FrozenBinarySearchTree in O(n), see BinarySearchTree::freeze. Its
+     * find and lower_bound take a Key.
+     * @return the FrozenBinarySearchTree.
+     */
+    FrozenBinarySearchTree<KeyValuePair<Key,Value>, FrozenCompare> freeze() const{
+        return FrozenBinarySearchTree<KeyValuePair<Key,Value>, FrozenCompare>(
+                tree.cbegin(), tree.cend(),
+                frozenCompare(tree.key_comp(), std::is_same<Compare, TreeLess>()));
+    }
+
+    /**
+     * Get the ordering of the Keys.
+     * @return copy of the Compare.
+     */
+    Compare key_comp() const{
+        return tree.key_comp().keyCompare;
+    }
+
+    /**
+     * Add every KeyValuePair of the other TreeMap whose Key is not in this one, see BinarySearchTree::unionWith.
+     * @param other TreeMap whose KeyValuePairs to take over, left empty.
+     * @param threads Number of threads to use.
+     */
+    void unionWith(TreeMap && other, unsigned threads = 1) {
+        tree.unionWith(std::move(other.tree), threads);
+    }
+
+    /**
+     * Keep only the KeyValuePairs whose Keys the other TreeMap has too, see BinarySearchTree::intersect.
+     * @param other TreeMap to intersect with, left empty.
+     * @param threads Number of threads to use.
+     */
+    void intersect(TreeMap && other, unsigned threads = 1) {
+        tree.intersect(std::move(other.tree), threads);
+    }
+
+    /**
+     * Remove every KeyValuePair whose Key the other TreeMap has, see BinarySearchTree::difference.
+     * @param other TreeMap whose Keys to remove, left empty.
+     * @param threads Number of threads to use.
+     */
+    void difference(TreeMap && other, unsigned threads = 1) {
+        tree.difference(std::move(other.tree), threads);
+    }
+
     /**
      * Insert a KeyValuePair into the BinarySearchTree stored inside.
      * @param k Key of the KeyValuePair.
@@ -89,7 +530,66 @@ public:
      * exists in the BinarySearchTree.
      */
     KeyValuePair<Key,Value> * insert(const Key & k, const Value & v) {
-        return &(tree.insert(KeyValuePair<Key,Value>(k,v))->data);
+        std::pair<KeyValuePair<Key,Value> *, bool> result = try_emplace(k, v);
+        return result.second ? result.first : nullptr;
+    }
+
+    /**
+     * Insert a KeyValuePair into the BinarySearchTree stored inside, moving the Key and the Value into it.
+     * Nothing is moved if the Key already exists.
+     * @param k Key of the KeyValuePair.
+     * @param v Value of the KeyValuePair.
+     * @return Pointer to the KeyValuePair<Key,Value> object if the insertion was successful, nullptr if the Key already
+     * exists in the BinarySearchTree.
+     */
+    KeyValuePair<Key,Value> * insert(Key && k, Value && v) {
+        std::pair<KeyValuePair<Key,Value> *, bool> result = try_emplace(std::move(k), std::move(v));
+        return result.second ? result.first : nullptr;
+    }
+
+    /**
+     * Construct a KeyValuePair in place from the provided arguments and insert it. The whole KeyValuePair has to be
+     * constructed before its Key can be compared, so prefer try_emplace when the Value is expensive to build.
+     * @param args Arguments to pass to the constructor of KeyValuePair<Key,Value>.
+     * @return Pointer to the new KeyValuePair<Key,Value>, nullptr if the Key already exists.
+     */
+    template<typename... Args>
+    KeyValuePair<Key,Value> * emplace(Args && ... args) {
+        TreeNode<KeyValuePair<Key,Value> > * node = tree.emplace(std::forward<Args>(args)...);
+        return node ? &node->data : nullptr;
+    }
+
+    /**
+     * If the Key is not in the TreeMap yet, insert it together with a Value constructed in place, inside the new
+     * TreeNode, from the provided arguments. If it is, nothing is constructed, copied or moved.
+     * @param k Key of the KeyValuePair.
+     * @param args Arguments to pass to the constructor of Value.
+     * @return Pointer to the KeyValuePair<Key,Value> with the Key, and true if it was newly inserted.
+     */
+    template<typename K, typename... Args>
+    std::pair<KeyValuePair<Key,Value> *, bool> try_emplace(K && k, Args && ... args) {
+        const Key & key = k;
+        std::pair<TreeNode<KeyValuePair<Key,Value> > *, bool> result =
+                tree.emplaceIfAbsent(key, ConstructInPlace(), std::forward<K>(k), std::forward<Args>(args)...);
+        return std::make_pair(&result.first->data, result.second);
+    }
+
+    /**
+     * Insert the Key with the provided Value, or assign the Value to the existing KeyValuePair if the Key is already
+     * in the TreeMap.
+     * @param k Key of the KeyValuePair.
+     * @param v Value to insert or assign.
+     * @return Pointer to the KeyValuePair<Key,Value> with the Key, and true if it was newly inserted.
+     */
+    template<typename K, typename V>
+    std::pair<KeyValuePair<Key,Value> *, bool> insert_or_assign(K && k, V && v) {
+        const Key & key = k;
+        std::pair<TreeNode<KeyValuePair<Key,Value> > *, bool> result =
+                tree.emplaceIfAbsent(key, ConstructInPlace(), std::forward<K>(k), std::forward<V>(v));
+        if(!result.second) {
+            result.first->data.v = std::forward<V>(v);
+        }
+        return std::make_pair(&result.first->data, result.second);
     }
 
     /**
@@ -101,15 +601,285 @@ public:
     }
 
     /**
-     * Look for the KeyValuePair in the BinarySearchTree stored inside.
+     * Write every KeyValuePair in order of the Keys, with the separator between them, see BinarySearchTree::write.
+     * @param o ostream object.
+     * @param separator Written between two KeyValuePairs.
+     * @param format Function taking the BufferedSink and a KeyValuePair that writes the KeyValuePair.
+     */
+    template<typename Formatter = StreamFormatter>
+    void write(ostream & o, const std::string & separator, Formatter format = Formatter()) const{
+        tree.write(o, separator, format);
+    }
+
+    /**
+     * Write every KeyValuePair whose Key is in [lo, hi) in order of the Keys, see BinarySearchTree::writeRange.
+     * @param o ostream object.
+     * @param lo Smallest Key to write.
+     * @param hi Smallest Key not to write.
+     * @param separator Written between two KeyValuePairs.
+     * @param format Function taking the BufferedSink and a KeyValuePair that writes the KeyValuePair.
+     */
+    template<typename Formatter = StreamFormatter>
+    void writeRange(ostream & o, const Key & lo, const Key & hi, const std::string & separator,
+                    Formatter format = Formatter()) const{
+        tree.writeRange(o, lo, hi, separator, format);
+    }
+
+    /**
+     * Write a binary snapshot of the TreeMap, see TreeMapFileHeader, which readBinary or MappedTreeMap can load.
+     * Only for trivially copyable Keys and Values, which are written as their raw bytes.
+     * @param o ostream object, opened in binary mode.
+     * @return true if everything was written.
+     */
+    bool writeBinary(ostream & o) const{
+        static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+                      "writeBinary needs trivially copyable Keys and Values");
+        static_assert(alignof(Key) <= TreeMapFileHeader::alignment && alignof(Value) <= TreeMapFileHeader::alignment,
+                      "writeBinary needs Keys and Values aligned to at most 16 bytes");
+        TreeMapFileHeader header = TreeMapFileHeader::make(sizeof(Key), sizeof(Value), size());
+        const char padding[TreeMapFileHeader::alignment] = {};
+        o.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        o.write(padding, header.keysOffset - sizeof(header));
+        writeInChunks(o, [](const KeyValuePair<Key,Value> & pair) { return pair.k; });
+        o.write(padding, header.valuesOffset - header.keysOffset - header.count * sizeof(Key));
+        writeInChunks(o, [](const KeyValuePair<Key,Value> & pair) { return pair.v; });
+        return static_cast<bool>(o);
+    }
+
+    /**
+     * Replace the contents of the TreeMap with a binary snapshot written by writeBinary, in O(n). The TreeMap is
+     * left empty if the snapshot is not valid for this Key and Value, is truncated or its Keys are out of order.
+     * @param in istream object, opened in binary mode.
+     * @return true if the snapshot was loaded.
+     */
+    bool readBinary(std::istream & in) {
+        static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+                      "readBinary needs trivially copyable Keys and Values");
+        tree.clear();
+        TreeMapFileHeader header;
+        if(!in.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+            return false;
+        }
+        // The size of a stream is not always known, so only the counts the header claims are checked here and
+        // a truncated stream is caught while reading
+        if(!header.isValid(sizeof(Key), sizeof(Value), header.valuesOffset + header.count * sizeof(Value))) {
+            return false;
+        }
+        std::vector<Key> keys;
+        std::vector<Value> values;
+        if(!in.ignore(header.keysOffset - sizeof(header)) || !readArray(in, keys, header.count)
+           || !in.ignore(header.valuesOffset - header.keysOffset - header.count * sizeof(Key))
+           || !readArray(in, values, header.count)) {
+            return false;
+        }
+        PairCompare comp = tree.key_comp();
+        if(std::adjacent_find(keys.begin(), keys.end(), [&](const Key & a, const Key & b) { return !comp(a, b); })
+           != keys.end()) {
+            return false;
+        }
+        std::vector<KeyValuePair<Key,Value> > elements;
+        elements.reserve(keys.size());
+        for(size_t i = 0; i < keys.size(); ++i) {
+            elements.emplace_back(keys[i], values[i]);
+        }
+        tree.insertSortedBatch(elements.begin(), elements.end());
+        return true;
+    }
+
+    /**
+     * Call the function on every KeyValuePair in order of the Keys, faster than iterating over the TreeMap.
+     * @param fn Function taking a reference to a KeyValuePair.
+     */
+    template<typename Fn>
+    void forEach(Fn fn) {
+        tree.forEach(fn);
+    }
+
+    template<typename Fn>
+    void forEach(Fn fn) const{
+        tree.forEach(fn);
+    }
+
+    /**
+     * Call the function on every KeyValuePair whose Key is in [lo, hi), in order of the Keys.
+     * @param lo Smallest Key to visit.
+     * @param hi Smallest Key not to visit.
+     * @param fn Function taking a reference to a KeyValuePair.
+     */
+    template<typename Fn>
+    void scan(const Key & lo, const Key & hi, Fn fn) {
+        tree.scan(lo, hi, fn);
+    }
+
+    template<typename Fn>
+    void scan(const Key & lo, const Key & hi, Fn fn) const{
+        tree.scan(lo, hi, fn);
+    }
+
+    /**
+     * Look for the KeyValuePair in the BinarySearchTree stored inside. The Key is compared with the stored
+     * KeyValuePairs directly, so neither a KeyValuePair nor a Value is built or copied.
      * @param k Key of the KeyValuePair.
-     * @param v Value of the KeyValuePair.
      * @return Pointer to the KeyValuePair<Key,Value> if it was found, nullptr if the Key does not exist in the BST.
      */
-    KeyValuePair<Key,Value> * find(Key k) {
-        KeyValuePair<Key,Value> pair (k);
-        TreeNode<KeyValuePair<Key, Value>> * treeNode = tree.find(pair);
-        return &treeNode->data;
+    KeyValuePair<Key,Value> * find(const Key & k) {
+        TreeNode<KeyValuePair<Key,Value> > * treeNode = tree.find(k);
+        return treeNode ? &treeNode->data : nullptr;
+    }
+
+    const KeyValuePair<Key,Value> * find(const Key & k) const{
+        TreeNode<KeyValuePair<Key,Value> > * treeNode = tree.find(k);
+        return treeNode ? &treeNode->data : nullptr;
+    }
+
+    /**
+     * Get the number of KeyValuePairs in the TreeMap, in O(1).
+     * @return number of KeyValuePairs.
+     */
+    size_t size() const{
+        return tree.size();
+    }
+
+    /**
+     * Count the Keys smaller than the provided one, in O(log n).
+     * @param k Key to look for.
+     * @return number of smaller Keys, which is the position of the Key if it is in the TreeMap.
+     */
+    size_t rank(const Key & k) const{
+        return tree.rank(k);
+    }
+
+    /**
+     * Find the KeyValuePair with the k-th smallest Key, in O(log n).
+     * @param k Position of the KeyValuePair, starting from 0.
+     * @return Pointer to the KeyValuePair<Key,Value>, nullptr if k is not smaller than size().
+     */
+    KeyValuePair<Key,Value> * select(size_t k) {
+        TreeNode<KeyValuePair<Key,Value> > * treeNode = tree.select(k);
+        return treeNode ? &treeNode->data : nullptr;
+    }
+
+    const KeyValuePair<Key,Value> * select(size_t k) const{
+        TreeNode<KeyValuePair<Key,Value> > * treeNode = tree.select(k);
+        return treeNode ? &treeNode->data : nullptr;
+    }
+
+    /**
+     * Find the first KeyValuePair whose Key is not smaller than the provided one, in O(log n).
+     * @param k Key to look for.
+     * @return TreeNodeIterator pointing to the KeyValuePair, end() if every Key is smaller.
+     */
+    iterator lower_bound(const Key & k) {
+        return tree.lower_bound(k);
+    }
+
+    const_iterator lower_bound(const Key & k) const{
+        return tree.lower_bound(k);
+    }
+
+    /**
+     * Find the first KeyValuePair whose Key is greater than the provided one, in O(log n).
+     * @param k Key to look for.
+     * @return TreeNodeIterator pointing to the KeyValuePair, end() if no Key is greater.
+     */
+    iterator upper_bound(const Key & k) {
+        return tree.upper_bound(k);
+    }
+
+    const_iterator upper_bound(const Key & k) const{
+        return tree.upper_bound(k);
+    }
+
+    /**
+     * Find the KeyValuePair with the provided Key, in O(log n).
+     * @param k Key to look for.
+     * @return lower_bound and upper_bound of the Key, equal to each other if the Key is not in the TreeMap.
+     */
+    std::pair<iterator, iterator> equal_range(const Key & k) {
+        return tree.equal_range(k);
+    }
+
+    std::pair<const_iterator, const_iterator> equal_range(const Key & k) const{
+        return tree.equal_range(k);
+    }
+
+    /**
+     * Get a view of the KeyValuePairs whose Keys are in [lo, hi), found in O(log n).
+     * @param lo Smallest Key to include.
+     * @param hi Smallest Key to exclude.
+     * @return TreeNodeRange of the KeyValuePairs.
+     */
+    TreeNodeRange<KeyValuePair<Key,Value> > range(const Key & lo, const Key & hi) {
+        return tree.range(lo, hi);
+    }
+
+    TreeNodeRange<KeyValuePair<Key,Value>, true> range(const Key & lo, const Key & hi) const{
+        return tree.range(lo, hi);
+    }
+
+    /**
+     * Get a TreeNodeIterator pointing to the KeyValuePair with the smallest Key.
+     * @return TreeNodeIterator pointing to the beginning of the TreeMap.
+     */
+    iterator begin() {
+        return tree.begin();
+    }
+
+    const_iterator begin() const{
+        return tree.begin();
+    }
+
+    const_iterator cbegin() const{
+        return tree.cbegin();
+    }
+
+    /**
+     * Get a TreeNodeIterator pointing past the KeyValuePair with the greatest Key.
+     * @return TreeNodeIterator pointing to the end of the TreeMap.
+     */
+    iterator end() {
+        return tree.end();
+    }
+
+    const_iterator end() const{
+        return tree.end();
+    }
+
+    const_iterator cend() const{
+        return tree.cend();
+    }
+
+    /**
+     * Get a reverse iterator pointing to the KeyValuePair with the greatest Key.
+     * @return reverse iterator pointing to the beginning of the reversed TreeMap.
+     */
+    reverse_iterator rbegin() {
+        return tree.rbegin();
+    }
+
+    const_reverse_iterator rbegin() const{
+        return tree.rbegin();
+    }
+
+    /**
+     * Get a reverse iterator pointing before the KeyValuePair with the smallest Key.
+     * @return reverse iterator pointing to the end of the reversed TreeMap.
+     */
+    reverse_iterator rend() {
+        return tree.rend();
+    }
+
+    const_reverse_iterator rend() const{
+        return tree.rend();
+    }
+
+    /**
+     * Remove the KeyValuePair with the provided Key from the BinarySearchTree stored inside.
+     * @param k Key of the KeyValuePair.
+     * @return true if the Key was in the TreeMap and got removed, false otherwise.
+     */
+    bool erase(const Key & k) {
+        return tree.erase(k);
     }
 
 };
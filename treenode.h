@@ -7,12 +7,43 @@ using std::cerr;
 using std::endl;
 using std::ostream;
 
+#include <cassert>
+#include <cstddef>
+#include <iterator>
 #include <memory>
 using std::unique_ptr;
 
+#include <type_traits>
 #include <utility>
 using std::pair;
 
+/**
+ * Tag telling a constructor to build its data in place from the rest of its arguments.
+ */
+struct ConstructInPlace {
+};
+
+template<typename T>
+class TreeNode;
+
+/**
+ * Deleter of the children of a TreeNode. A TreeNode built with new on its own owns its children and deletes them with
+ * it, but the TreeNodes of a BinarySearchTree come from its allocator and are only ever given back through it: the
+ * tree releases every TreeNode from its parent before destroying it. Deleting one of those here is a bug, which is
+ * caught by an assert instead of handing allocator memory to delete.
+ */
+struct TreeNodeDeleter {
+
+    template<typename T>
+    void operator()(TreeNode<T> * node) const{
+        assert(!node->fromAllocator && "a TreeNode of a BinarySearchTree must be freed through its allocator");
+        if(!node->fromAllocator) {
+            delete node;
+        }
+    }
+
+};
+
 // TODO your code for the TreeNode class goes here:
 /**
  * TreeNode represents a binary TreeNode.
@@ -26,10 +57,16 @@ class TreeNode {
 
 public:
 
+    typedef unique_ptr<TreeNode, TreeNodeDeleter> ChildPointer;
+
     T data;
-    unique_ptr<TreeNode> leftChild;
-    unique_ptr<TreeNode> rightChild;
+    ChildPointer leftChild;
+    ChildPointer rightChild;
     TreeNode * parent;
+    int height;
+    // Set by the BinarySearchTree for the TreeNodes it creates through its allocator, fits in the padding after height
+    bool fromAllocator;
+    size_t size;
 
     /**
      * Constructor of the TreeNode object when its paren TreeNode is known.
@@ -37,7 +74,8 @@ public:
      * @param parentNode Parent node of the TreeNode.
      */
     TreeNode(T data, TreeNode * parentNode)
-            : data(std::move(data)), parent(parentNode), leftChild(nullptr), rightChild(nullptr) {
+            : data(std::move(data)), leftChild(nullptr), rightChild(nullptr), parent(parentNode), height(1),
+              fromAllocator(false), size(1) {
     }
 
     /**
@@ -45,7 +83,18 @@ public:
      * @param data Data to be stored in the TreeNode.
      */
     explicit TreeNode(T data)
-            : data(std::move(data)), parent(nullptr), leftChild(nullptr), rightChild(nullptr)  {
+            : data(std::move(data)), leftChild(nullptr), rightChild(nullptr), parent(nullptr), height(1),
+              fromAllocator(false), size(1) {
+    }
+
+    /**
+     * Constructor of the TreeNode that constructs its data in place, without any temporary.
+     * @param args Arguments to pass to the constructor of T.
+     */
+    template<typename... Args>
+    explicit TreeNode(ConstructInPlace, Args && ... args)
+            : data(std::forward<Args>(args)...), leftChild(nullptr), rightChild(nullptr), parent(nullptr), height(1),
+              fromAllocator(false), size(1) {
     }
 
     /**
@@ -72,20 +121,42 @@ public:
 
     /**
      * Get the representation of node's children and node itself..
+     * Walks the subtree in order by following the parent pointers, so it needs no recursion and no stack and works
+     * for a subtree of any shape.
      * @param o ostream object.
      */
     void write(ostream& o) const{
-        if(leftChild) {
-            (leftChild)->write(o);
+        const TreeNode * node = this;
+        while(node->leftChild) {
+            node = node->leftChild.get();
         }
-        o << " " << data << " ";
-        if(rightChild) {
-            (rightChild)->write(o);
+        for(;;) {
+            o << " " << node->data << " ";
+            if(node->rightChild) {
+                node = node->rightChild.get();
+                while(node->leftChild) {
+                    node = node->leftChild.get();
+                }
+                continue;
+            }
+            // Climb until coming up from a left child, whose parent is the next one, or out of the subtree
+            for(;;) {
+                if(node == this) {
+                    return;
+                }
+                const TreeNode * nodesParent = node->parent;
+                bool fromLeft = nodesParent->leftChild.get() == node;
+                node = nodesParent;
+                if(fromLeft) {
+                    break;
+                }
+            }
         }
     }
 
     /**
-     * Get max depth from this TreeNode.
+     * Get max depth from this TreeNode by walking the whole subtree.
+     * Unlike the cached height this does not rely on the tree keeping it up to date.
      * @return max depth.
      */
     int maxDepth() {
@@ -147,13 +218,32 @@ public:
         return nullptr;
     }
 
+    /**
+     * Recalculate the cached height of this TreeNode from the cached heights of its children.
+     * Does not touch the ancestors, the caller is responsible for walking up the tree if needed.
+     */
+    void updateHeight() {
+        int leftSubtreeHeight = leftChild ? leftChild->height : 0;
+        int rightSubtreeHeight = rightChild ? rightChild->height : 0;
+        height = leftSubtreeHeight > rightSubtreeHeight? (leftSubtreeHeight + 1) : (rightSubtreeHeight + 1);
+    }
+
+    /**
+     * Recalculate the cached number of TreeNodes in the subtree of this TreeNode from the sizes of its children.
+     * Does not touch the ancestors, the caller is responsible for walking up the tree if needed.
+     */
+    void updateSize() {
+        size = 1 + (leftChild ? leftChild->size : 0) + (rightChild ? rightChild->size : 0);
+    }
+
     /**
      * Get the balance factor of the TreeNode.
+     * Uses the cached heights of the children, so it is O(1).
      * @return balance factor.
      */
-    int balanceFactor() {
-        int leftSubtreeHeight = leftChild->maxDepth();
-        int rightSubtreeHeight = rightChild->maxDepth();
+    int balanceFactor() const{
+        int leftSubtreeHeight = leftChild ? leftChild->height : 0;
+        int rightSubtreeHeight = rightChild ? rightChild->height : 0;
         return leftSubtreeHeight - rightSubtreeHeight;
     }
 
@@ -168,75 +258,178 @@ public:
 // ====================================================================================================================
 
 /**
- * TreeNodeIterator used to iterate over TreeNode objects.
+ * TreeNodeIterator used to iterate over TreeNode objects in both directions.
+ * Stepping to the next or previous TreeNode follows the child and parent links, which is amortized O(1).
+ * The end iterator holds no TreeNode, it remembers the root of the tree instead so that it can be decremented.
  * @tparam T Data type stored in the current TreeNode.
+ * @tparam IsConst true for an iterator that only gives read access to the data.
  *
  * @author Vakaris Paulavičius (K20062023)
- * @version 1.1
+ * @version 1.2
  */
-template<typename T>
+template<typename T, bool IsConst = false>
 class TreeNodeIterator {
 
+    template<typename U, bool OtherIsConst>
+    friend class TreeNodeIterator;
+
+public:
+
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef typename std::conditional<IsConst, const T *, T *>::type pointer;
+    typedef typename std::conditional<IsConst, const T &, T &>::type reference;
+    typedef typename std::conditional<IsConst, const TreeNode<T> *, TreeNode<T> *>::type NodePointer;
+
 private:
 
-    TreeNode<T> * current;
+    NodePointer current;
+    const typename TreeNode<T>::ChildPointer * root;
+
+    /**
+     * Find the TreeNode with the smallest data in the subtree of the provided TreeNode.
+     * @param node Root of the subtree, not nullptr.
+     * @return leftmost TreeNode of the subtree.
+     */
+    static NodePointer leftmost(NodePointer node) {
+        while(node->leftChild) {
+            node = node->leftChild.get();
+        }
+        return node;
+    }
+
+    /**
+     * Find the TreeNode with the greatest data in the subtree of the provided TreeNode.
+     * @param node Root of the subtree, not nullptr.
+     * @return rightmost TreeNode of the subtree.
+     */
+    static NodePointer rightmost(NodePointer node) {
+        while(node->rightChild) {
+            node = node->rightChild.get();
+        }
+        return node;
+    }
+
+    /**
+     * Move to the TreeNode that goes after the current one, or to the end if there is none.
+     */
+    void increment() {
+        if(current->rightChild) {
+            current = leftmost(current->rightChild.get());
+            return;
+        }
+        NodePointer child = current;
+        current = current->parent;
+        while(current && current->rightChild.get() == child) {
+            child = current;
+            current = current->parent;
+        }
+    }
+
+    /**
+     * Move to the TreeNode that goes before the current one. Decrementing the end moves to the last TreeNode, or
+     * stays at the end if the tree is empty.
+     */
+    void decrement() {
+        if(!current) {
+            assert(root && "an end TreeNodeIterator made without the root of its tree can not be decremented");
+            if(*root) {
+                current = rightmost(root->get());
+            }
+            return;
+        }
+        if(current->leftChild) {
+            current = rightmost(current->leftChild.get());
+            return;
+        }
+        NodePointer child = current;
+        current = current->parent;
+        while(current && current->leftChild.get() == child) {
+            child = current;
+            current = current->parent;
+        }
+    }
 
 public:
 
     /**
-     * TreeNodeIterator constructor.
+     * TreeNodeIterator constructor. An iterator made this way can not be decremented from the end, which asserts.
      * @param currentIn pointer to the initial TreeNode<T> of the iterator.
      */
-    explicit TreeNodeIterator(TreeNode<T>* currentIn)
-            : current(currentIn) {
+    explicit TreeNodeIterator(NodePointer currentIn)
+            : current(currentIn), root(nullptr) {
+    }
+
+    /**
+     * TreeNodeIterator constructor.
+     * @param currentIn pointer to the initial TreeNode<T> of the iterator, nullptr for the end.
+     * @param rootIn root of the tree the iterator goes over.
+     */
+    TreeNodeIterator(NodePointer currentIn, const typename TreeNode<T>::ChildPointer * rootIn)
+            : current(currentIn), root(rootIn) {
+    }
+
+    /**
+     * Convert a TreeNodeIterator into one that only gives read access to the data.
+     * @param other TreeNodeIterator to convert.
+     */
+    template<bool OtherIsConst, typename = typename std::enable_if<IsConst && !OtherIsConst>::type>
+    TreeNodeIterator(const TreeNodeIterator<T, OtherIsConst> & other)
+            : current(other.current), root(other.root) {
     }
 
     /**
      * Return data stored in the current object of the iterator.
      * @return T data of the current object.
      */
-    T & operator*() {
+    reference operator*() const{
         return current->data;
     }
 
+    /**
+     * Access a member of the data stored in the current object of the iterator.
+     * @return pointer to the data of the current object.
+     */
+    pointer operator->() const{
+        return &current->data;
+    }
 
     /**
      * Increment the TreeNodeIterator so that it points to the next element in the BinarySearchTree.
+     * @return this TreeNodeIterator.
      */
-    void operator++() {
-        TreeNode<T> * temp = current;
-        if(temp->rightChild) {
-            if((temp->rightChild)->leftChild) {
-                current = temp->findLeftmostChild();
-            }
-            else {
-                current = temp->rightChild.get();
-            }
-        }
-        else {
-            current = temp->findNextTreeNodeWhenRightChildIsNull();
-        }
+    TreeNodeIterator & operator++() {
+        increment();
+        return *this;
     }
 
     /**
      * Increment the TreeNodeIterator so that it points to the next element in the BinarySearchTree.
-     * @return TreeNodeIterator object.
-     */
-    TreeNodeIterator<T> operator++(int)
-    {
-        TreeNodeIterator<T> itr = *this;
-        TreeNode<T> * temp = current;
-        if(temp->rightChild) {
-            if((temp->rightChild)->leftChild) {
-                current = temp->findLeftmostChild();
-            }
-            else {
-                current = temp->rightChild.get();
-            }
-        }
-        else {
-            current = temp->findNextTreeNodeWhenRightChildIsNull();
-        }
+     * @return TreeNodeIterator object pointing to the element before the increment.
+     */
+    TreeNodeIterator operator++(int) {
+        TreeNodeIterator itr = *this;
+        increment();
+        return itr;
+    }
+
+    /**
+     * Decrement the TreeNodeIterator so that it points to the previous element in the BinarySearchTree.
+     * @return this TreeNodeIterator.
+     */
+    TreeNodeIterator & operator--() {
+        decrement();
+        return *this;
+    }
+
+    /**
+     * Decrement the TreeNodeIterator so that it points to the previous element in the BinarySearchTree.
+     * @return TreeNodeIterator object pointing to the element before the decrement.
+     */
+    TreeNodeIterator operator--(int) {
+        TreeNodeIterator itr = *this;
+        decrement();
         return itr;
     }
 
@@ -246,7 +439,8 @@ public:
      * @param other Another NodeIterator to compare to.
      * @return true if they are the same, false otherwise.
      */
-    bool operator ==(const TreeNodeIterator other) const{
+    template<bool OtherIsConst>
+    bool operator ==(const TreeNodeIterator<T, OtherIsConst> & other) const{
         return current == other.current;
     }
 
@@ -256,7 +450,8 @@ public:
      * @param other Another NodeIterator to compare to.
      * @return true if they are different, false otherwise.
      */
-    bool operator !=(const TreeNodeIterator other) const{
+    template<bool OtherIsConst>
+    bool operator !=(const TreeNodeIterator<T, OtherIsConst> & other) const{
         return current != other.current;
     }
 
@@ -264,11 +459,178 @@ public:
      * Get a pointer to the Node that this Iterator is pointing to.
      * @return current Node.
      */
-    TreeNode<T> * getNode() {
+    NodePointer getNode() const{
         return current;
     }
 
 };
+
+// ====================================================================================================================
+
+/**
+ * TreeNodeRange is a view of the elements between two TreeNodeIterators, usable in a range-based for loop.
+ * @tparam T Data type stored in the TreeNodes.
+ * @tparam IsConst true for a view that only gives read access to the data.
+ *
+ * @author Vakaris Paulavičius (K20062023)
+ * @version 1.0
+ */
+template<typename T, bool IsConst = false>
+class TreeNodeRange {
+
+private:
+
+    TreeNodeIterator<T, IsConst> first;
+    TreeNodeIterator<T, IsConst> last;
+    size_t count;
+
+public:
+
+    /**
+     * TreeNodeRange constructor.
+     * @param firstIn TreeNodeIterator pointing to the first element of the range.
+     * @param lastIn TreeNodeIterator pointing past the last element of the range.
+     * @param countIn Number of elements in the range.
+     */
+    TreeNodeRange(TreeNodeIterator<T, IsConst> firstIn, TreeNodeIterator<T, IsConst> lastIn, size_t countIn)
+            : first(firstIn), last(lastIn), count(countIn) {
+    }
+
+    /**
+     * Get a TreeNodeIterator pointing to the first element of the range.
+     * @return TreeNodeIterator pointing to the beginning of the range.
+     */
+    TreeNodeIterator<T, IsConst> begin() const{
+        return first;
+    }
+
+    /**
+     * Get a TreeNodeIterator pointing past the last element of the range.
+     * @return TreeNodeIterator pointing to the end of the range.
+     */
+    TreeNodeIterator<T, IsConst> end() const{
+        return last;
+    }
+
+    /**
+     * Get the number of elements in the range.
+     * @return number of elements.
+     */
+    size_t size() const{
+        return count;
+    }
+
+    /**
+     * Check whether the range has no elements.
+     * @return true if the range is empty.
+     */
+    bool empty() const{
+        return count == 0;
+    }
+
+};
+
+// ====================================================================================================================
+
+/**
+ * InOrderStack is the explicit stack of an in-order walk over a binary tree, so that the walk needs neither recursion
+ * nor parent pointers. It has a fixed size: an AVL tree is at most 1.44 * log2(n + 2) high, which stays below 100
+ * for any n that fits in memory.
+ * @tparam Node Node type, whose leftChild and rightChild are raw pointers or smart pointers with get().
+ *
+ * @author Vakaris Paulavičius (K20062023)
+ * @version 1.0
+ */
+template<typename Node>
+class InOrderStack {
+
+public:
+
+    static const int maxDepth = 128;
+
+private:
+
+    Node * nodes[maxDepth];
+    int top;
+
+public:
+
+    /**
+     * Constructor of an empty InOrderStack.
+     */
+    InOrderStack()
+            : top(0) {
+    }
+
+    /**
+     * Get the node a child pointer points to.
+     * @param child leftChild or rightChild of a node, held in a smart pointer.
+     * @return the child, nullptr if there is none.
+     */
+    template<typename Pointer>
+    static auto get(const Pointer & child) -> decltype(child.get()) {
+        return child.get();
+    }
+
+    static Node * get(Node * child) {
+        return child;
+    }
+
+    /**
+     * Push a node on the stack.
+     * @param node Node to visit after the ones pushed later.
+     */
+    void push(Node * node) {
+        nodes[top++] = node;
+    }
+
+    /**
+     * Push a node and every node on the way down to its leftmost descendant, so the leftmost one is popped first.
+     * @param node Root of a subtree, can be nullptr.
+     */
+    void pushLeftSpine(Node * node) {
+        while(node) {
+            push(node);
+            node = get(node->leftChild);
+        }
+    }
+
+    /**
+     * Take the node pushed last off the stack.
+     * @return the node.
+     */
+    Node * pop() {
+        return nodes[--top];
+    }
+
+    /**
+     * Check whether there is no node left on the stack.
+     * @return true if the stack is empty.
+     */
+    bool empty() const{
+        return top == 0;
+    }
+
+};
+
+template<typename Node>
+const int InOrderStack<Node>::maxDepth;
+
+/**
+ * Call the function on every node of a binary tree in order, walking it with an InOrderStack.
+ * @param root Root of the tree, can be nullptr.
+ * @param fn Function taking a pointer to a node.
+ */
+template<typename Node, typename Fn>
+void forEachInOrder(Node * root, Fn && fn) {
+    InOrderStack<Node> stack;
+    stack.pushLeftSpine(root);
+    while(!stack.empty()) {
+        Node * node = stack.pop();
+        fn(node);
+        stack.pushLeftSpine(InOrderStack<Node>::get(node->rightChild));
+    }
+}
 // do not edit below this line
 
 #endif